@@ -0,0 +1,353 @@
+#include "simulation.h"
+#include "software_renderer.h"
+#include "utils.h"
+#include "alloc_tracker.h"
+#include "score_store.h"
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+// Micro-benchmarks of the simulation's hot functions. Prints one JSON
+// object per line, so runs of different builds can be diffed or plotted.
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed_ns(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+uint64_t get_allocations() {
+  return AllocTracker::get_counts().allocations;
+}
+
+}  // namespace
+
+class Bench {
+public:
+  Bench(const Simulation::Settings & settings, float speed);
+  void run(const char * filter);
+  // Largest difference between generate_game_walls and the column by
+  // column recurrence it computes in closed form
+  float get_generation_error();
+  const static float max_generation_error;
+  const static int num_entities = 50000;
+private:
+  struct Result {
+    double ns;
+    uint64_t allocations;
+    long ops;
+  };
+  // Each benchmark returns the time and allocations of its timed part
+  Result generate_game_walls(long ops);
+  Result erase_old_walls(long ops);
+  Result player_inside(long ops);
+  Result player_update(long ops);
+  Result update(long ops);
+  Result entities_update(long ops);
+  Result software_render(long ops);
+  void report(const char * name, const Result & result, double items_per_op);
+  Simulation::Settings settings;
+  Simulation simulation;
+  float speed;
+  float delta_time;
+};
+
+const float Bench::max_generation_error = 1e-2f;
+const int Bench::num_entities;
+
+Bench::Bench(const Simulation::Settings & settings, float speed)
+  : settings(settings), simulation(settings), speed(speed), delta_time(1.0f/240) {
+  simulation.init(1);
+  simulation.start_playing(speed);
+  simulation.generate_course(delta_time);
+}
+
+void Bench::run(const char * filter) {
+  struct Entry {
+    const char * name;
+    Result (Bench::*function)(long);
+    long ops;
+    double items_per_op;
+  };
+  double columns = settings.num_types * SCREEN_WIDTH / settings.walls_width;
+  Entry entries[] = {
+    { "generate_game_walls", &Bench::generate_game_walls, 2000, columns },
+    { "erase_old_walls", &Bench::erase_old_walls, 2000, columns },
+    { "player_inside", &Bench::player_inside, 200000, 1 },
+    { "player_update", &Bench::player_update, 1000000, 1 },
+    { "update", &Bench::update, 100000, 1 },
+    { "entities_update", &Bench::entities_update, 1000, double(num_entities) },
+    { "software_render", &Bench::software_render, 1000, 1 },
+  };
+  for (const Entry & entry : entries) {
+    if (filter and !strstr(entry.name, filter)) continue;
+    report(entry.name, (this->*entry.function)(entry.ops), entry.items_per_op);
+  }
+}
+
+Bench::Result Bench::generate_game_walls(long ops) {
+  Result result = { 0.0, 0, ops };
+  for (long op = 0; op < ops; ++op) {
+    simulation.restart_lanes();
+    uint64_t start_allocations = get_allocations();
+    Clock::time_point start = Clock::now();
+    simulation.generate_course(delta_time);
+    result.ns += elapsed_ns(start);
+    result.allocations += get_allocations() - start_allocations;
+  }
+  return result;
+}
+
+float Bench::get_generation_error() {
+  simulation.restart_lanes();
+  std::vector<Lane> start = simulation.get_lanes();
+  simulation.generate_course(delta_time);
+  float error = 0.0f;
+  for (int type = 0; type < settings.num_types; ++type) {
+    const Lane & lane = simulation.get_lanes()[type];
+    float last_x = start[type].get_x(0) + settings.walls_width;
+    float last_y = start[type].get_y(0);
+    float last_height = start[type].get_height(0);
+    float target_y, target_height, time_left;
+    simulation.get_lane_target(type, target_y, target_height, time_left);
+    float column_time = settings.walls_width/simulation.get_speed();
+    float factor = std::max(1.0f, 3.0f*(1-time_left));
+    for (int i = 1; i < lane.size(); ++i) {
+      last_y += (target_y - last_y)*column_time*factor;
+      last_height += (target_height - last_height)*column_time;
+      error = std::max(error, std::abs(lane.get_x(i) - last_x));
+      error = std::max(error, std::abs(lane.get_y(i) - last_y));
+      error = std::max(error, std::abs(lane.get_height(i) - last_height));
+      last_x += settings.walls_width;
+    }
+  }
+  return error;
+}
+
+Bench::Result Bench::erase_old_walls(long ops) {
+  Result result = { 0.0, 0, ops };
+  for (long op = 0; op < ops; ++op) {
+    simulation.restart_lanes();
+    simulation.generate_course(delta_time);
+    // Every column is off the screen
+    float x = simulation.get_scroll() + SCREEN_WIDTH + 2*settings.walls_width;
+    uint64_t start_allocations = get_allocations();
+    Clock::time_point start = Clock::now();
+    simulation.erase_walls_before(x);
+    result.ns += elapsed_ns(start);
+    result.allocations += get_allocations() - start_allocations;
+  }
+  return result;
+}
+
+Bench::Result Bench::player_inside(long ops) {
+  simulation.restart_lanes();
+  simulation.generate_course(delta_time);
+  int inside = 0;
+  uint64_t start_allocations = get_allocations();
+  Clock::time_point start = Clock::now();
+  for (long op = 0; op < ops; ++op) {
+    inside += simulation.player_inside(true);
+  }
+  Result result = { elapsed_ns(start), get_allocations() - start_allocations, ops };
+  if (inside < 0) std::cerr << inside;  // Keep the calls
+  return result;
+}
+
+Bench::Result Bench::player_update(long ops) {
+  uint64_t start_allocations = get_allocations();
+  Clock::time_point start = Clock::now();
+  for (long op = 0; op < ops; ++op) {
+    // Hold up and down in turns, tapping the color key now and then
+    unsigned int keys = (op/100)%2 ? (1u<<Input::PLAYER_UP) : (1u<<Input::PLAYER_DOWN);
+    if (op%50 == 0) keys |= (1u<<Input::PLAYER_ACTION);
+    simulation.update_player(delta_time, keys);
+  }
+  return { elapsed_ns(start), get_allocations() - start_allocations, ops };
+}
+
+Bench::Result Bench::update(long ops) {
+  Result result = { 0.0, 0, ops };
+  // The walls so far were generated without the steps moving between them
+  simulation.start_playing(speed);
+  for (long op = 0; op < ops; ++op) {
+    if (simulation.get_status() != Simulation::PLAYING) simulation.start_playing(speed);
+    unsigned int keys = (op/100)%2 ? (1u<<Input::PLAYER_UP) : (1u<<Input::PLAYER_DOWN);
+    uint64_t start_allocations = get_allocations();
+    Clock::time_point start = Clock::now();
+    simulation.update(delta_time, keys);
+    result.ns += elapsed_ns(start);
+    result.allocations += get_allocations() - start_allocations;
+  }
+  return result;
+}
+
+Bench::Result Bench::entities_update(long ops) {
+  Entities entities(num_entities);
+  Random random(1);
+  for (int i = 0; i < num_entities; ++i) {
+    Entities::Kind kind = Entities::Kind(random.next(Entities::K_SIZE));
+    Entities::Handle handle = entities.spawn(kind, 0, random.next(SCREEN_WIDTH),
+                                             random.next(SCREEN_HEIGHT), 6.0f, 12.0f);
+    entities.set_motion(handle, 60.0f, 0.0f, SCREEN_HEIGHT);
+  }
+  // Nothing scrolls out and the player touches nothing, so every op does the same work
+  const sf::Vector2f pos(-100.0f, 0.0f), size(20.0f, 20.0f);
+  int touched = 0;
+  uint64_t start_allocations = get_allocations();
+  Clock::time_point start = Clock::now();
+  for (long op = 0; op < ops; ++op) {
+    entities.update(delta_time, -100.0f);
+    touched += entities.collide(pos, size).pickups;
+  }
+  Result result = { elapsed_ns(start), get_allocations() - start_allocations, ops };
+  if (touched < 0) std::cerr << touched;  // Keep the calls
+  return result;
+}
+
+Bench::Result Bench::software_render(long ops) {
+  simulation.restart_lanes();
+  simulation.generate_course(delta_time);
+  SoftwareRenderer renderer;
+  uint64_t start_allocations = get_allocations();
+  Clock::time_point start = Clock::now();
+  for (long op = 0; op < ops; ++op) {
+    renderer.render(simulation);
+  }
+  return { elapsed_ns(start), get_allocations() - start_allocations, ops };
+}
+
+void Bench::report(const char * name, const Result & result, double items_per_op) {
+  double ns_per_op = result.ns/result.ops;
+  std::cout << "{\"name\": \"" << name << "\""
+            << ", \"walls_width\": " << settings.walls_width
+            << ", \"lanes\": " << settings.num_types
+            << ", \"speed\": " << speed
+            << ", \"ops\": " << result.ops
+            << ", \"ns_per_op\": " << ns_per_op
+            << ", \"allocs_per_op\": " << double(result.allocations)/result.ops
+            << ", \"items_per_s\": " << items_per_op*1e9/ns_per_op
+            << "}" << std::endl;
+}
+
+namespace {
+
+std::string read_file(const std::string & file) {
+  std::ifstream in(file.c_str(), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string & file, const std::string & data) {
+  std::ofstream out(file.c_str(), std::ios::binary | std::ios::trunc);
+  out.write(data.data(), data.size());
+}
+
+bool same_runs(const std::vector<ScoreStore::Run> & a, const std::vector<ScoreStore::Run> & b) {
+  if (a.size() != b.size()) return false;
+  for (unsigned int i = 0; i < a.size(); ++i) {
+    if (a[i].score != b[i].score or a[i].duration != b[i].duration or a[i].seed != b[i].seed or
+        a[i].timestamp != b[i].timestamp) return false;
+  }
+  return true;
+}
+
+// Compares get_top and get_day with the same queries answered by sorting
+// runs, which are in time order
+bool check_queries(const ScoreStore & scores, const std::vector<ScoreStore::Run> & runs, const char * when) {
+  const int64_t seconds_per_day = 86400;
+  std::vector<ScoreStore::Run> top = runs;
+  std::stable_sort(top.begin(), top.end(),
+                   [](const ScoreStore::Run & a, const ScoreStore::Run & b) { return a.score > b.score; });
+  top.resize(std::min(top.size(), size_t(10)));
+  bool ok = same_runs(scores.get_top(10), top);
+  for (const ScoreStore::Run & run : runs) {
+    std::vector<ScoreStore::Run> day;
+    for (const ScoreStore::Run & other : runs) {
+      if (other.timestamp/seconds_per_day == run.timestamp/seconds_per_day) day.push_back(other);
+    }
+    ok = ok and same_runs(scores.get_day(run.timestamp), day);
+  }
+  if (!ok) std::cerr << "Score queries disagree with sorted runs " << when << std::endl;
+  return ok;
+}
+
+// Queries the score store after a compaction, and after reopening it with
+// runs left in the journal behind a torn write, as a crash would
+bool check_scores() {
+  char directory[] = "/tmp/kyc-bench-XXXXXX";
+  if (!mkdtemp(directory)) return false;
+  std::string path = std::string(directory) + "/scores";
+  ScoreStore scores;
+  scores.open(path);
+  // The best score of older versions, if there is one where this runs
+  std::vector<ScoreStore::Run> runs = scores.get_top(1);
+  bool ok = true;
+  const int num_runs = 200, compacted_runs = 150;
+  // Runs a few hours apart over several days, with distinct scores
+  for (int i = 0; i < num_runs; ++i) {
+    ScoreStore::Run run = { (i*7919)%10007, i*0.5f, uint64_t(i), 1700000000 + i*5000LL };
+    if (i == compacted_runs) {
+      // Compacts the first runs, the others stay in the journal
+      scores.close();
+      scores.open(path);
+      ok = check_queries(scores, runs, "after a compaction");
+    }
+    scores.add(run);
+    runs.push_back(run);
+  }
+  scores.flush();
+  std::string database = read_file(path + ".db");
+  std::string journal = read_file(path + ".journal");
+  scores.close();
+  // Back to before the compaction on close, with half of a run written
+  size_t entry_size = journal.size()/(num_runs - compacted_runs);
+  write_file(path + ".db", database);
+  write_file(path + ".journal", journal + journal.substr(0, entry_size/2));
+  scores.open(path);
+  ok = ok and check_queries(scores, runs, "after reopening with a torn journal");
+  scores.close();
+  if (!read_file(path + ".journal").empty()) {
+    std::cerr << "Score journal left after a compaction" << std::endl;
+    ok = false;
+  }
+  scores.open(path);
+  ok = ok and check_queries(scores, runs, "after compacting a repaired journal");
+  scores.close();
+  unlink((path + ".db").c_str());
+  unlink((path + ".journal").c_str());
+  rmdir(directory);
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char * argv[]) {
+  const char * filter = argc > 1 ? argv[1] : NULL;
+  const float widths[] = { 1.0f, 2.0f, 4.0f, 8.0f };
+  const int lane_counts[] = { 2, 4, 8 };
+  const float speeds[] = { 300.0f, 1000.0f, 3000.0f };
+  for (float width : widths) {
+    for (int lanes : lane_counts) {
+      for (float speed : speeds) {
+        Simulation::Settings settings;
+        settings.walls_width = width;
+        settings.num_types = lanes;
+        Bench bench(settings, speed);
+        bench.run(filter);
+        float error = bench.get_generation_error();
+        if (error > Bench::max_generation_error) {
+          std::cerr << "generate_game_walls is " << error << " off the recurrence with walls_width "
+                    << width << ", " << lanes << " lanes, speed " << speed << std::endl;
+          return 1;
+        }
+      }
+    }
+  }
+  if (!check_scores()) return 1;
+  return 0;
+}
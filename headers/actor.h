@@ -4,24 +4,28 @@
 #include "utils.h"
 
 // Forward declaration
-class Game;
+class Simulation;
 
 class Actor {
  public:
-  Actor(Game & game, int type, float speed);
+  Actor(Simulation & simulation, int type, float speed);
   virtual ~Actor();
   virtual void update(float delta_time) = 0;
-  virtual void render() = 0;
-  int get_type();
+  int get_type() const;
   void set_type(int type);
   void set_speed(float speed);
-  const sf::Vector2f & get_pos();
+  const sf::Vector2f & get_pos() const;
+  // Position alpha of the way from the last to the current one
+  sf::Vector2f get_pos(float alpha) const;
+  // Keeps the current position to interpolate from
+  void save_pos();
   static std::vector<sf::Color> colors;
  protected:
-  Game & game;
+  Simulation & simulation;
   int type;
   float speed;
   sf::Vector2f pos;
+  sf::Vector2f last_pos;
 
 };
 
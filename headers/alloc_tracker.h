@@ -0,0 +1,42 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Counts every allocation made through the global operator new, which
+// src/alloc_tracker.cc replaces, in total and per thread. Code that must
+// not allocate runs under an AllocGuard; with checking on, an allocation
+// there prints a stack trace, and with ABORT also stops the program.
+class AllocTracker {
+public:
+  enum Check { OFF, LOG, ABORT, C_SIZE };
+  struct Counts {
+    uint64_t allocations;
+    uint64_t bytes;
+  };
+  // Since the start, over every thread
+  static Counts get_counts();
+  // Since the start, in the calling thread
+  static Counts get_thread_counts();
+  static void set_check(Check check);
+  static const char * get_name(Check check);
+  // Check named name, or C_SIZE if there is none
+  static Check get_check(const char * name);
+  // Called by operator new
+  static void record(std::size_t size);
+  // Stack traces printed at most, so a leak per frame does not flood the log
+  const static int max_reports = 32;
+};
+
+// Allocations in the calling thread are checked while a guard with active
+// set is alive. An inactive guard exempts a scope inside an active one.
+class AllocGuard {
+public:
+  AllocGuard(bool active = true);
+  ~AllocGuard();
+private:
+  bool previous;
+};
+
+#endif  // ALLOC_TRACKER_H
@@ -0,0 +1,22 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <cstddef>
+
+// Files built into the executable by the assembler, so loading them needs
+// no file system access and no copy. The data lives in the read-only
+// segment for the whole run, which is what SFML's loadFromMemory expects
+// of fonts.
+class Assets {
+public:
+  struct Asset {
+    // Path relative to the source tree, like fonts/Audiowide-Regular.ttf
+    const char * name;
+    const void * data;
+    std::size_t size;
+  };
+  // The built-in file with that path, or NULL
+  static const Asset * find(const char * name);
+};
+
+#endif  // ASSETS_H
@@ -0,0 +1,23 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include "simulation.h"
+
+// Scripted input policy for unattended runs. It starts games, steers the
+// player towards the middle of its lane a little ahead, and changes color
+// when its lane gets too narrow and another one covers the player.
+class Autopilot {
+public:
+  Autopilot();
+  ~Autopilot();
+  // Key bitset to feed the simulation's next update
+  unsigned int get_keys(const Simulation & simulation);
+private:
+  // Presses action only if it was released last step, so it is a new press
+  unsigned int tap();
+  const static float look_ahead;
+  const static float margin;
+  unsigned int last_keys;
+};
+
+#endif  // AUTOPILOT_H
@@ -0,0 +1,159 @@
+#ifndef COURSE_GENERATOR_H
+#define COURSE_GENERATOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "utils.h"
+#include "lane.h"
+#include "random.h"
+
+// Generates the columns of a game being played, one simulation step at a
+// time, on the caller's thread or ahead of it on a thread of its own. The
+// producer writes each step's columns to a ring per lane and then a record
+// of the step, with the generation state after it, to a ring of steps. The
+// consumer pops a record and its columns. Each side only moves its own end
+// of the rings and publishes it with a release store, so neither locks,
+// and the difficulty reaches the simulation with the step it belongs to.
+// Both ways give the same columns, split at the same points, as lanes
+// generated in place would have. The producer moves the scroll and speed
+// of the coming steps with the same functions as playing does. Whatever
+// else changes the lanes or the motion, the simulation marks with a new
+// generation number, and the steps made ahead are then dropped and
+// generation starts over from where the simulation is. So does a step
+// foreseen at another scroll or speed than the simulation's. A side that finds the rings empty or full parks on a
+// condition variable, woken by the other side only when it is waiting.
+class CourseGenerator {
+public:
+  // Everything generation reads and changes besides the columns
+  struct State {
+    // As seen by the generation of a step, after the speed and scroll update
+    float speed;
+    float target_speed;
+    float scroll;
+    float walls_next_target_timeout;
+    float walls_next_target_timer;
+    int one_way_probability;
+    int walls_target[Lane::max_lanes];
+    int walls_next_target[Lane::max_lanes];
+    int walls_last_target[Lane::max_lanes];
+    Random rng;
+  };
+  // What stays the same for a simulation
+  struct Config {
+    int num_types;
+    float walls_width;
+    // Before Lane rounds it up to a power of two
+    int lane_capacity;
+    int walls_max_dist;
+    float min_walls_next_target_timeout;
+    float walls_min_height;
+    float rebase_distance;
+    std::vector<float> target_positions;
+  };
+  // Threaded only if the machine runs two threads at once
+  CourseGenerator(const Config & config, bool threaded);
+  // Stops the producer thread
+  ~CourseGenerator();
+  // Appends the columns of the step to lanes and updates the generation
+  // fields of state, the simulation's state when it generates. Steps are
+  // taken in order, one per simulation step of delta_time, while
+  // generation stays the same; a new one starts generation over. Waits if
+  // the producer is behind
+  void take_step(unsigned int generation, float delta_time, State & state, std::vector<Lane> & lanes);
+  // Drops the steps made ahead, until the next take_step starts over
+  void stop();
+  bool is_threaded() const;
+  // Steps the producer works ahead of the consumer, at most
+  const static int max_steps_ahead = 64;
+  // Columns held per lane, in screens, the most a step can add
+  const static int column_screens = 16;
+  // Motion shared with the simulation, so the producer foresees it exactly.
+  // Every step moves speed towards target_speed, then scroll by speed, and
+  // returns whether scroll reached rebase_distance, for the caller to take
+  // it off
+  static bool move(float delta_time, float target_speed, float rebase_distance,
+                   float & speed, float & scroll);
+  // Every playing step raises the target speed
+  static void speed_up(float delta_time, float & target_speed);
+  // out[k] = start + (k+1)*step
+  static void fill_linear(float * out, int count, float start, float step);
+  // Closed form of value += (target - value)*(1 - ratio) applied k+1 times:
+  // out[k] = target + (start - target)*ratio^(k+1)
+  static void fill_smoothed(float * out, int count, float start, float target, float ratio);
+private:
+  // Last column of a lane, and the lane's column count
+  struct Tail {
+    float x;
+    float y;
+    float height;
+    unsigned int end;
+    bool empty;
+  };
+  struct Step {
+    // Speed and scroll the step was generated for, the rest after it
+    State state;
+    int counts[Lane::max_lanes];
+  };
+  void start(unsigned int generation, float delta_time, const State & state, const std::vector<Lane> & lanes);
+  // Waits until the next step is made, making it here when not threaded
+  const Step & next_step();
+  // Producer side: generates one step, false if stopped meanwhile
+  bool produce();
+  // Writes count columns from scratch to the ring of type
+  bool push_columns(int type, int count);
+  // Parks until the consumer has taken the steps before begin, false if
+  // stopped meanwhile
+  bool wait_for_room(unsigned int begin);
+  // Counts the columns of the steps taken as free again
+  void update_freed();
+  int get_missing_columns(const Tail & tail) const;
+  void run();
+  const Config config;
+  const bool threaded;
+  unsigned int generation;
+  int lane_mask;
+  unsigned int column_capacity;
+  unsigned int column_mask;
+  float delta_time;
+  bool started;
+
+  // Shared rings, columns of lane type start at type*column_capacity
+  std::vector<Step> steps;
+  std::vector<float> column_x;
+  std::vector<float> column_y;
+  std::vector<float> column_height;
+  std::atomic<unsigned int> steps_begin;
+  std::atomic<unsigned int> steps_end;
+
+  // Consumer side
+  unsigned int read_columns[Lane::max_lanes];
+
+  // Producer side
+  State state;
+  Tail tails[Lane::max_lanes];
+  unsigned int write_columns[Lane::max_lanes];
+  unsigned int freed_columns[Lane::max_lanes];
+  unsigned int freed_steps;
+  std::vector<float> scratch_x;
+  std::vector<float> scratch_y;
+  std::vector<float> scratch_height;
+
+  // Starting and stopping the producer thread, and parking either side
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable stopped;
+  std::condition_variable filled;
+  std::condition_variable room;
+  std::atomic<bool> active;
+  bool idle;
+  bool quitting;
+  std::atomic<bool> consumer_waiting;
+  std::atomic<bool> producer_waiting;
+  // steps_begin the parked producer waits for
+  std::atomic<unsigned int> room_begin;
+};
+
+#endif  // COURSE_GENERATOR_H
@@ -0,0 +1,86 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <cstdint>
+#include "utils.h"
+
+// Pool of the small gameplay objects that ride along the lanes. Each kind
+// keeps its live entities packed in its own structure of arrays, allocated
+// once for the whole capacity, and is updated by one loop with no virtual
+// calls. Entities are referred to by generational handles, which go stale
+// when their entity is destroyed, so a handle to a reused slot is harmless.
+// Positions are in world coordinates, like the lanes.
+class Entities {
+public:
+  enum Kind {
+    BLOCKER,  // Moves up and down between two heights, ends the game
+    GATE,     // Changes the player to its color
+    PICKUP,   // Adds to the score and disappears
+    K_SIZE
+  };
+  struct Handle {
+    uint32_t index;
+    uint32_t generation;
+  };
+  // Packed components of the live entities of one kind
+  struct Group {
+    int count;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> width;
+    std::vector<float> height;
+    std::vector<int> type;
+    // Blockers only, vertical speed and the range they bounce in
+    std::vector<float> speed;
+    std::vector<float> min_y;
+    std::vector<float> max_y;
+    // Handle index of each entity, to fix its slot when it moves
+    std::vector<uint32_t> slot;
+  };
+  // What a rectangle touched
+  struct Hits {
+    bool blocked;
+    // Type of the last gate touched, or -1
+    int gate_type;
+    int pickups;
+  };
+  Entities(int capacity);
+  ~Entities();
+  // Copies only the groups of live entities, into the arrays already
+  // allocated when the capacities match. Handles are not copied, so the
+  // copy is for reading the groups and drawing them
+  Entities & operator=(const Entities & other);
+  // Destroys every entity, invalidating all handles
+  void clear();
+  // Returns a handle with index capacity if the pool is full
+  Handle spawn(Kind kind, int type, float x, float y, float width, float height);
+  // Makes the blocker of handle bounce between min_y and max_y
+  void set_motion(Handle handle, float speed, float min_y, float max_y);
+  bool is_alive(Handle handle) const;
+  void destroy(Handle handle);
+  int size() const;
+  int capacity() const;
+  const Group & get_group(Kind kind) const;
+  // Moves blockers and drops the entities that scrolled past left
+  void update(float delta_time, float left);
+  // What the rectangle at pos touches, collecting the pickups it does
+  Hits collide(const sf::Vector2f & pos, const sf::Vector2f & size);
+  // Moves every entity by dx, as Lane::shift does
+  void shift(float dx);
+  // Color an entity is drawn with
+  static sf::Color get_color(Kind kind, int type);
+private:
+  struct Slot {
+    uint32_t generation;
+    int kind;
+    int index;
+  };
+  // Removes entity index of group kind, moving the last one in its place
+  void remove(int kind, int index);
+  Group groups[K_SIZE];
+  std::vector<Slot> slots;
+  std::vector<uint32_t> free_slots;
+  int free_count;
+};
+
+#endif  // ENTITIES_H
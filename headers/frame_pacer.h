@@ -0,0 +1,52 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <cstdint>
+#include "utils.h"
+#include "profiler.h"
+
+// Decides when frames start and end, and measures the time from an input
+// event to the display of the first frame that reflects it.
+//   VSYNC:       display() blocks until the vertical blank.
+//   LOW_LATENCY: no vsync; waits before the frame, so that input is read
+//                as late as possible and the frame ends on its deadline.
+//   CAP:         no vsync; waits after the frame, at most rate frames/s.
+class FramePacer {
+public:
+  enum Mode { VSYNC, LOW_LATENCY, CAP, M_SIZE };
+  FramePacer();
+  ~FramePacer();
+  // rate is the frames per second aimed at when not using vsync
+  void set_mode(Mode mode, float rate);
+  Mode get_mode() const;
+  bool uses_vsync() const;
+  // Call before reading input for a frame
+  void begin_frame();
+  // Call after display()
+  void end_frame();
+  // event_time and present_time from Profiler::now()
+  void add_latency(int64_t event_time, int64_t present_time);
+  // Milliseconds from input to display over the recent inputs
+  Profiler::Stats get_latency() const;
+  int get_latency_count() const;
+  static const char * get_name(Mode mode);
+  // Mode named name, or M_SIZE if there is none
+  static Mode get_mode(const char * name);
+  // Sleeps while far from time and spins the rest, sleeps overshoot
+  static void wait_until(int64_t time);
+  const static int num_latencies = 4096;
+private:
+  Mode mode;
+  int64_t period;
+  // When the current frame should be done
+  int64_t deadline;
+  int64_t frame_start;
+  // Time a frame takes, rising at once and falling slowly
+  int64_t work_estimate;
+  std::vector<int64_t> latencies;
+  int latency_count;
+  const static int64_t spin_time;
+  const static int64_t margin;
+};
+
+#endif  // FRAME_PACER_H
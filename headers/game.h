@@ -1,79 +1,145 @@
 #ifndef GAME_H
 #define GAME_H
 
-#include <functional>
 #include "utils.h"
 #include "input.h"
-#include "actor.h"
-#include "player.h"
-#include "wall.h"
+#include "simulation.h"
+#include "lane_renderer.h"
 #include "gui.h"
+#include "replay.h"
+#include "score_store.h"
+#include "triple_buffer.h"
+#include "frame_pacer.h"
+#include "alloc_tracker.h"
+#include "versus.h"
+#include <atomic>
+#include <thread>
 
+// Everything drawn in a frame, copied out of the simulation so it can be
+// drawn while the next steps run
+struct Snapshot {
+  Snapshot();
+  std::vector<Lane> lanes;
+  Entities entities;
+  float scroll;
+  float last_scroll;
+  sf::Vector2f player_pos;
+  sf::Vector2f player_last_pos;
+  sf::Vector2f player_size;
+  int player_type;
+  // The other player in versus mode, in this player's screen coordinates
+  bool ghost_visible;
+  sf::Vector2f ghost_pos;
+  sf::Vector2f ghost_last_pos;
+  int ghost_type;
+  int status;
+  int score;
+  int timeout;
+  bool show_profiler;
+  // Overlay stats, read on the frame thread that writes them while shown
+  Profiler::Stats profiler_stats[Profiler::Z_SIZE];
+  Profiler::AllocStats profiler_allocs[Profiler::Z_SIZE];
+  // Fraction of a step left in the accumulator, and Profiler::now(), when published
+  float alpha;
+  int64_t time;
+  // Oldest input event reflected here and not displayed yet, or 0
+  int64_t input_time;
+};
+
+// Windowed front end: polls events and the keyboard, steps the simulation
+// and draws it. Each frame's state is published as a Snapshot, drawn by
+// the same thread or, with set_render_thread, by a thread of its own so a
+// display blocked on vsync does not hold back input and simulation.
 class Game {
 public:
-  Game(int width, int height, std::string title, int style);
+  Game(int width, int height, std::string title, int style,
+       const Simulation::Settings & settings = Simulation::Settings());
   ~Game();
-  bool init();
+  bool init(uint64_t seed);
   void run();
-  sf::RenderWindow & get_window();
-  const Input & get_input();
-  enum Status { MENU, READY, PLAYING, GAME_OVER, S_SIZE };
+  // Simulation steps per second, independent of the display refresh
+  void set_rate(int rate);
+  // Takes the keys of each step from replay until it ends
+  void set_replay(Replay * replay);
+  // Writes the keys of each step to recorder
+  void set_recorder(Recorder * recorder);
+  // Races the other side of lockstep, showing its player as a ghost
+  void set_lockstep(Lockstep * lockstep);
+  void set_render_thread(bool render_thread);
+  // See FramePacer, rate is only used without vsync
+  void set_pacing(FramePacer::Mode mode, float rate);
+  // Profiler::now() when the process started, to report how long startup
+  // took once the first frame is displayed
+  void set_start_time(int64_t time);
+  const static int default_rate;
 private:
-  void update(float delta_time);
-  std::function<void(float)> status_update;
-  void menu_update(float delta_time);
-  void ready_update(float delta_time);
-  void playing_update(float delta_time);
-  void game_over_update(float delta_time);
+  // Handles window events, queuing key presses and releases with the time
+  // they were read
   void process_events();
-  void render();
-  // Clear everything in game
-  void clear();
-  // Different kinds of generation
-  void generate_game_walls(float delta_time);
-  void generate_ready_walls();
-  void generate_menu_walls();
-  void generate_walls();
-  void erase_old_walls();
-  // Check if player is inside a wall of its type
-  bool player_inside();
+  // Applies the queued key events up to time, and returns the Input key
+  // bits of a step ending then
+  unsigned int take_keys(int64_t time);
+  // Keeps the values the hud shows and stores finished runs
+  void update_hud();
+  // Copies the state to draw into the write snapshot and publishes it
+  void publish(float alpha);
+  void render_loop();
+  // Draws the newest snapshot, interpolated up to now
+  void draw();
+  // Pass status, score and timeout changes of the snapshot to the gui
+  void update_gui(const Snapshot & snapshot);
+  // Draws alpha of the way between the last two simulation steps
+  void render(const Snapshot & snapshot, float alpha);
+  // Writes the four corners of a rectangle to a quad
+  static void write_quad(sf::Vertex * quad, const sf::Vector2f & pos, const sf::Vector2f & size,
+                         const sf::Color & color);
+  // Writes a quad per entity, every kind in one vertex array
+  void render_entities(const Entities & entities, float scroll);
+  // Longest frame the simulation catches up on, longer ones slow it down
+  const static float max_frame_time;
   sf::RenderWindow window;
-  Input input;
-  Gui * gui;
-
-  // Static members
-  const static int num_types;
-  const static float game_over_speed;
-  const static float ready_speed;
-  const static float start_speed;
-  const static float walls_width;
-  const static float walls_min_height;
-  const static int walls_max_dist;
-  const static int num_positions;
-  const static float init_walls_next_target_timeout;
-  const static float min_walls_next_target_timeout;
-  const static int init_one_way_probability;
-
-  // speed
-  float speed;
-  float target_speed;
-  // Walls
-  float walls_next_target_timeout;
-  float walls_next_target_timer;
-  int max_distance;
-  int one_way_probability;
-  std::vector<int> walls_target;
-  std::vector<int> walls_next_target;
-  std::vector<int> walls_last_target;
-  std::vector<float> target_positions;
-
-  Player* player;
-  std::vector<std::list<Wall*>> all_walls;
-
-  int status;
-  float time_to_start;
-  float score;
-  float total_time;
+  const Simulation::Settings settings;
+  Simulation simulation;
+  Gui gui;
+  ScoreStore scores;
+  // Written by the simulation thread, read by the render thread
+  TripleBuffer<Snapshot> snapshots;
+  std::vector<LaneRenderer> lane_renderers;
+  sf::VertexArray entity_vertices;
+  // Kept between frames, unlike a shape, so drawing the player does not allocate
+  sf::VertexArray player_vertices;
+  sf::VertexArray ghost_vertices;
+  int last_status;
+  int hud_score;
+  int hud_timeout;
+  bool show_profiler;
+  int drawn_status;
+  float step_time;
+  Replay * replay;
+  Recorder * recorder;
+  Versus * versus;
+  bool threaded;
+  FramePacer pacer;
+  struct KeyEvent {
+    int64_t time;
+    int key;
+    bool pressed;
+  };
+  // Ring of key events not taken by a step yet
+  const static int max_key_events = 64;
+  KeyEvent key_events[max_key_events];
+  unsigned int key_events_begin;
+  unsigned int key_events_end;
+  unsigned int keys_down;
+  // Input event not reflected by a step yet, and one reflected but not displayed
+  int64_t event_time;
+  int64_t input_time;
+  std::atomic<int64_t> presented_input_time;
+  // Startup times, start_time is cleared once the first frame is displayed
+  int64_t start_time;
+  int64_t init_time;
+  std::atomic<bool> running;
+  std::thread render_thread;
 };
 
 #endif  // GAME_H
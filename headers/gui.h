@@ -1,30 +1,45 @@
 #ifndef UI_H
 #define UI_H
 
+#include <cstdint>
 #include "utils.h"
-
-class Game;
+#include "hud_text.h"
+#include "profiler.h"
 
 class Gui {
 public:
-  Gui(Game & game);
+  Gui();
   ~Gui();
   bool init();
-  void render();
+  void render(sf::RenderTarget & target);
   void update();
   void set_score(int score);
   void set_timeout(int timeout);
   void set_status(int status);
-  void save_score();
+  // Seed shown on the game over screen, to replay a course
+  void set_seed(uint64_t seed);
+  void set_best_score(int best_score);
+  // Shows or hides the frame profiler overlay
+  void set_profiler_visible(bool visible);
+  // Stats the overlay shows, one per zone
+  void set_profiler_stats(const Profiler::Stats * stats, const Profiler::AllocStats * allocs);
 private:
-  Game & game;
   int status;
   int index;
   int score;
   int best_score;
   int timeout;
+  uint64_t seed;
   sf::Font font;
   std::vector<sf::Text> text;
+  // Playing and ready texts change every second or faster
+  HudText score_text;
+  HudText timeout_text;
+  bool show_profiler;
+  int profiler_frames;
+  Profiler::Stats profiler_stats[Profiler::Z_SIZE];
+  Profiler::AllocStats profiler_allocs[Profiler::Z_SIZE];
+  sf::Text profiler_text;
 };
 
 #endif  // UI_H
@@ -0,0 +1,37 @@
+#ifndef HUD_TEXT_H
+#define HUD_TEXT_H
+
+#include "utils.h"
+
+// A fixed label followed by an integer, drawn from glyphs rasterized once
+// into the font's texture. Numbers are formatted into a char buffer and
+// only the quads from the first changed character on are rewritten, so
+// updating and drawing allocate nothing and take one draw call.
+class HudText {
+public:
+  HudText();
+  ~HudText();
+  void init(const sf::Font & font, unsigned int size, const sf::Color & color, const char * label);
+  void set_number(int number);
+  void render(sf::RenderTarget & target) const;
+  const static int max_chars = 48;
+private:
+  // Writes characters from index on, from the pen position at index
+  void write_chars(int index);
+  struct Glyph {
+    sf::FloatRect bounds;
+    sf::FloatRect texture;
+    float advance;
+  };
+  const sf::Font * font;
+  unsigned int size;
+  // Empty for characters out of the charset
+  Glyph glyphs[128];
+  sf::VertexArray vertices;
+  char chars[max_chars];
+  float pen[max_chars+1];
+  int label_length;
+  int length;
+};
+
+#endif  // HUD_TEXT_H
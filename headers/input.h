@@ -13,14 +13,22 @@ public:
   };
   Input();
   ~Input();
-  void update();
+  // Key bound to a keyboard key, or K_SIZE if there is none
+  static Key get_key(sf::Keyboard::Key code);
+  // Latches a new key bitset, keeping the previous one for edges. Bit key
+  // is set if the key is down at the end of the step, and bit
+  // key + tap_shift if it was pressed and released within the step
+  void update(unsigned int keys);
+  unsigned int get_keys() const;
+  // Down at the end of the step or for part of it
   bool key_down(int key) const;
   bool key_pressed(int key) const;
   bool key_released(int key) const;
+  const static int tap_shift = 8;
 private:
-  bool key_status[K_SIZE];
-  bool old_key_status[K_SIZE];
-  sf::Keyboard::Key key_mapping[K_SIZE];
+  unsigned int key_status;
+  unsigned int old_key_status;
+  static const sf::Keyboard::Key key_mapping[K_SIZE];
 };
 
 #endif  // INPUT_H
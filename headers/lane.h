@@ -0,0 +1,71 @@
+#ifndef LANE_H
+#define LANE_H
+
+#include "utils.h"
+
+// Columns of one color, kept in a fixed-capacity ring buffer laid out as
+// structure of arrays. Nothing is allocated after construction. Columns are
+// in world coordinates, they do not move as the game scrolls.
+class Lane {
+public:
+  Lane(int type, float width, int capacity);
+  ~Lane();
+  int get_type() const;
+  float get_width() const;
+  int size() const;
+  int capacity() const;
+  bool empty() const;
+  // Appends a column at the back, dropping the front one if the lane is full
+  void push_back(float x, float y, float height);
+  void pop_front();
+  void clear();
+  // Contiguous slots after the back, to write up to count columns in
+  // place before commit_back adds them. Front columns are dropped to make
+  // room, as push_back does. Returns how many slots there are.
+  int get_back_segment(int count, float *& x, float *& y, float *& height);
+  void commit_back(int count);
+  // Running count of popped and pushed columns, to track what changed
+  unsigned int get_first() const;
+  unsigned int get_end() const;
+  // Columns are indexed from the front (leftmost) of the lane
+  float get_x(int i) const;
+  float get_y(int i) const;
+  float get_height(int i) const;
+  bool contains_point(int i, const sf::Vector2f & p) const;
+  // Index of the column under x, or -1 if x is outside the lane. Columns
+  // are contiguous and equally wide, so this is a subtraction and a product.
+  int get_index(float x) const;
+  // Column under x clamped to the lane, or -1 if the lane is empty
+  int get_nearest(float x) const;
+  // Whether any column contains p, looking only at the ones around p.x
+  bool contains_point(const sf::Vector2f & p) const;
+  // Whether the corners of a rectangle moving in a straight line from
+  // `from` to `to` stay inside the lane at every moment in between, column
+  // by column. x must not decrease. The end position is not tested.
+  bool contains_swept(const sf::Vector2f & from, const sf::Vector2f & to,
+                      const sf::Vector2f & size) const;
+  // Bit type is set if lanes[type] contains the four corners of the
+  // rectangle at pos, by the same test as contains_point. Four lanes are
+  // tested per SSE instruction.
+  static unsigned int get_coverage(const std::vector<Lane> & lanes, const sf::Vector2f & pos,
+                                   const sf::Vector2f & size);
+  const static int max_lanes = 16;
+  // Moves every column by dx, which bumps the epoch
+  void shift(float dx);
+  // Changes whenever columns move, so copies can tell theirs are stale
+  unsigned int get_epoch() const;
+private:
+  int slot(int i) const;
+  int type;
+  float width;
+  float inv_width;
+  int mask;
+  unsigned int first;
+  unsigned int end;
+  unsigned int epoch;
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> height;
+};
+
+#endif  // LANE_H
@@ -0,0 +1,29 @@
+#ifndef LANE_RENDERER_H
+#define LANE_RENDERER_H
+
+#include "utils.h"
+#include "lane.h"
+
+// Keeps one quad per ring slot of a lane in a persistent vertex array.
+// Quads are in world coordinates like the lane, so only the columns pushed
+// or popped since the last sync change, and the whole lane is one draw call.
+class LaneRenderer {
+public:
+  LaneRenderer(const Lane & lane);
+  ~LaneRenderer();
+  // Brings the quads up to date with the lane, rewriting them all if the
+  // lane's columns moved
+  void sync(const Lane & lane);
+  // Draws the lane as seen from a camera at scroll
+  void render(sf::RenderTarget & target, float scroll) const;
+private:
+  void write_quad(unsigned int seq, const sf::Vector2f & pos, const sf::Vector2f & size);
+  sf::VertexArray vertices;
+  sf::Color color;
+  unsigned int mask;
+  unsigned int first;
+  unsigned int end;
+  unsigned int epoch;
+};
+
+#endif  // LANE_RENDERER_H
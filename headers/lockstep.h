@@ -0,0 +1,102 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <cstdint>
+#include <netinet/in.h>
+#include "utils.h"
+#include "profiler.h"
+
+// Packet layout, all little endian:
+//   session (4 bytes), first step of the receiver's keys not received yet
+//   (4 bytes), step of the first keys carried (4 bytes), count (1 byte),
+//   count key bitsets (2 bytes each), the sender's step count (4 bytes)
+//   and its state hash after that many steps (8 bytes)
+
+// Exchanges the key bitset of every simulation step with one other
+// instance over UDP, so both can step the same simulations in the same
+// order. Local keys are used input_delay steps after they are read, which
+// gives them time to reach the other side before it needs them. Every
+// packet carries all the local keys not acknowledged yet, so a lost packet
+// is made up for by the next one, and the state hash of the last step, so
+// the two sides can tell when they stop agreeing. Nothing is allocated
+// after open.
+class Lockstep {
+public:
+  Lockstep();
+  ~Lockstep();
+  // Listens on port and sends to host:remote_port. Packets of another
+  // session, a run with other settings, are dropped
+  bool open(int port, const std::string & host, int remote_port, uint32_t session, int input_delay);
+  void close();
+  bool is_open() const;
+  int get_input_delay() const;
+  // Step the next keys are for, counted from 0
+  uint32_t get_step() const;
+  // Whether the local keys of get_step() + input delay were not given yet
+  bool needs_keys() const;
+  // Takes keys as the local keys of get_step() + input delay if they are
+  // needed, and sends every local key the other side has not acknowledged
+  void send(unsigned int keys);
+  // Reads the packets that arrived, without blocking
+  void receive();
+  // Receives until the other side's keys of get_step() arrive or timeout
+  // nanoseconds pass, sending again now and then. Returns ready()
+  bool wait(int64_t timeout);
+  bool ready() const;
+  // Keys of get_step() for each side, once ready
+  unsigned int get_local_keys() const;
+  unsigned int get_remote_keys() const;
+  // Moves to the next step, given the state hashes of the local simulation
+  // and of the copy of the remote one after the step. The first is sent,
+  // the second checked against the hash the other side sends
+  void end_step(uint64_t local_hash, uint64_t remote_hash);
+  // First step after which the two sides disagree, or -1
+  int64_t get_desync_step() const;
+  // Sends until the other side has every local key, for at most timeout
+  // nanoseconds, so it can finish the steps this side did
+  void flush(int64_t timeout);
+  // Milliseconds from sending keys to the first packet acknowledging them
+  Profiler::Stats get_round_trip() const;
+  // Milliseconds of the waits that found the other side's keys missing
+  Profiler::Stats get_wait() const;
+  int get_wait_count() const;
+  const static int max_input_delay = 32;
+  const static int max_packet_keys = 64;
+  const static int num_samples = 4096;
+private:
+  void transmit();
+  void read_packet(const uint8_t * packet, int size);
+  void check_hash(uint32_t steps, uint64_t hash);
+  // Steps held by the key and hash rings, more than either side can run ahead
+  const static int ring_size = 256;
+  const static int64_t resend_interval;
+  int socket_fd;
+  sockaddr_in address;
+  uint32_t session;
+  int input_delay;
+  uint32_t step;
+  // Local keys of the steps before local_end, acknowledged before ack
+  uint16_t local_keys[ring_size];
+  int64_t send_times[ring_size];
+  uint32_t local_end;
+  uint32_t ack;
+  // Remote keys of the steps before remote_end
+  uint16_t remote_keys[ring_size];
+  uint32_t remote_end;
+  // Hash of the remote copy after each recent step
+  uint64_t remote_hashes[ring_size];
+  // Local hash sent with every packet, after step steps
+  uint64_t local_hash;
+  // Hash the other side sent after more steps than run here yet
+  uint64_t pending_hash;
+  uint32_t pending_steps;
+  int64_t desync_step;
+  int64_t last_send;
+  bool warned_session;
+  std::vector<int64_t> round_trips;
+  int round_trip_count;
+  std::vector<int64_t> waits;
+  int wait_count;
+};
+
+#endif  // LOCKSTEP_H
@@ -7,11 +7,10 @@
 
 class Player : public Actor {
 public:
-  Player(Game & game, int type, float speed);
+  Player(Simulation & simulation, int type, float speed);
   ~Player();
   void update(float delta_time);
-  void render(); 
-  const sf::Vector2f get_size();
+  const sf::Vector2f get_size() const;
   void set_pos(const sf::Vector2f & pos);
 private:
   sf::Vector2f size;
@@ -0,0 +1,77 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include "utils.h"
+#include "alloc_tracker.h"
+
+// Frame profiler. Zones add their time and the allocations made in them by
+// the frame thread to the current frame's slot in a ring of recent frames,
+// and to a ring of trace events that can be written as Chrome trace-event
+// JSON. There is one writer, the frame thread. Stats are read on it as
+// well, from the complete frames; other threads get copies of them.
+class Profiler {
+public:
+  enum Zone {
+    FRAME, EVENTS, UPDATE, RENDER,
+    MENU_UPDATE, READY_UPDATE, PLAYING_UPDATE, GAME_OVER_UPDATE,
+    Z_SIZE
+  };
+  struct Stats {
+    float p50;
+    float p99;
+    float max;
+  };
+  struct AllocStats {
+    // In the last complete frame
+    uint64_t allocations;
+    uint64_t bytes;
+    // Most in one of the recent complete frames
+    uint64_t max_allocations;
+  };
+  static Profiler & instance();
+  void set_enabled(bool enabled);
+  bool is_enabled() const;
+  // Closes the current frame and starts a new, empty one
+  void begin_frame();
+  void add(Zone zone, int64_t start, int64_t duration, const AllocTracker::Counts & allocations);
+  // Nanoseconds on a monotonic clock
+  static int64_t now();
+  static const char * get_name(Zone zone);
+  // Milliseconds per frame spent in zone, over the recent complete frames.
+  // Only on the frame thread
+  Stats get_stats(Zone zone) const;
+  AllocStats get_alloc_stats(Zone zone) const;
+  bool write_trace(const std::string & path) const;
+  const static int num_frames = 256;
+  const static int num_events = 1<<16;
+private:
+  Profiler();
+  struct Event {
+    int zone;
+    int64_t start;
+    int64_t duration;
+  };
+  bool enabled;
+  int64_t epoch;
+  std::atomic<unsigned int> frame;
+  std::atomic<unsigned int> event_end;
+  int64_t frame_times[Z_SIZE][num_frames];
+  AllocTracker::Counts frame_allocations[Z_SIZE][num_frames];
+  std::vector<Event> events;
+};
+
+// Adds the time and the thread's allocations from its construction to its
+// destruction to a zone
+class ProfileZone {
+public:
+  ProfileZone(Profiler::Zone zone);
+  ~ProfileZone();
+private:
+  Profiler::Zone zone;
+  int64_t start;
+  AllocTracker::Counts start_allocations;
+};
+
+#endif  // PROFILER_H
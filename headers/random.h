@@ -0,0 +1,22 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// xoshiro128** generator. Each simulation owns one, so runs are
+// reproducible from their seed and instances share no hidden state.
+class Random {
+public:
+  Random(uint64_t seed = 0);
+  ~Random();
+  void seed(uint64_t seed);
+  uint64_t get_seed() const;
+  uint32_t next();
+  // Uniform integer in [0, n)
+  int next(int n);
+private:
+  uint64_t initial_seed;
+  uint32_t state[4];
+};
+
+#endif  // RANDOM_H
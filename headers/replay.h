@@ -0,0 +1,56 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include "utils.h"
+
+// Recording file layout, all little endian:
+//   "KYCR", version (1 byte), steps per second (4 bytes), seed (8 bytes),
+//   lanes (1 byte, from version 2, 2 before)
+// followed by runs of identical key bitsets, each one a varint count of
+// steps and the 2 byte bitset.
+namespace replay {
+  const char magic[4] = {'K', 'Y', 'C', 'R'};
+  const uint8_t version = 2;
+}
+
+// Writes the key bitset of every simulation step to a file
+class Recorder {
+public:
+  Recorder();
+  ~Recorder();
+  bool open(const std::string & path, int rate, uint64_t seed, int lanes);
+  void record(unsigned int keys);
+  // Writes the pending run and closes the file
+  void close();
+  bool is_open() const;
+private:
+  void write_run();
+  std::ofstream file;
+  unsigned int keys;
+  uint64_t count;
+};
+
+// Reads back a recording, one key bitset per simulation step
+class Replay {
+public:
+  Replay();
+  ~Replay();
+  bool open(const std::string & path);
+  int get_rate() const;
+  uint64_t get_seed() const;
+  int get_lanes() const;
+  // Sets keys to the next step's bitset, false once the recording ends
+  bool next(unsigned int & keys);
+private:
+  bool read_run();
+  std::vector<uint8_t> data;
+  size_t offset;
+  int rate;
+  uint64_t seed;
+  int lanes;
+  unsigned int keys;
+  uint64_t count;
+};
+
+#endif  // REPLAY_H
@@ -0,0 +1,69 @@
+#ifndef SCORE_STORE_H
+#define SCORE_STORE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "utils.h"
+
+// Store of every finished run. New runs are appended to a journal by a
+// background thread, so adding one never waits on the disk. Every so often
+// the journal is compacted into a memory-mapped database, written to a
+// temporary file and renamed over the old one, with runs sorted by time
+// plus indices by score and by day. Journal entries carry a checksum and
+// an id, so a torn write is dropped and a journal already merged into the
+// database is skipped after a power cut.
+class ScoreStore {
+public:
+  struct Run {
+    int32_t score;
+    float duration;
+    uint64_t seed;
+    int64_t timestamp;
+  };
+  ScoreStore();
+  // Writes pending runs, compacts and stops the writer thread
+  ~ScoreStore();
+  // Loads path.db and path.journal and starts the writer thread
+  bool open(const std::string & path);
+  void close();
+  // Queues a run for writing, never blocks on the disk
+  void add(const Run & run);
+  // Waits until every run added so far is in the journal
+  void flush();
+  int get_best_score() const;
+  // Best k runs, best first
+  std::vector<Run> get_top(int k) const;
+  // Runs of the UTC day of timestamp, in time order
+  std::vector<Run> get_day(int64_t timestamp) const;
+private:
+  struct Entry {
+    uint64_t id;
+    Run run;
+  };
+  void write_loop();
+  bool write_journal(const std::vector<Entry> & entries);
+  bool compact();
+  void load_journal();
+  std::string path;
+  int journal_fd;
+  int journal_entries;
+  const uint8_t * map;
+  size_t map_size;
+  uint64_t next_id;
+  int best_score;
+  // Runs not yet in the database, and the ones not yet in the journal
+  std::vector<Entry> tail;
+  std::vector<Entry> queue;
+  // Id of the last run written to the journal
+  uint64_t written_id;
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable written;
+  bool stopping;
+  std::thread writer;
+  const static int compact_entries = 64;
+};
+
+#endif  // SCORE_STORE_H
@@ -0,0 +1,163 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "utils.h"
+#include "input.h"
+#include "actor.h"
+#include "player.h"
+#include "lane.h"
+#include "random.h"
+#include "entities.h"
+#include "course_generator.h"
+
+// Game state and rules, with no window, drawing or event polling, so it
+// can be stepped headless as fast as the CPU allows.
+class Simulation {
+public:
+  // What can differ between instances, the defaults being the stock game
+  struct Settings {
+    Settings();
+    int num_types;
+    float walls_width;
+    // Difficulty curve
+    float start_speed;
+    int walls_max_dist;
+    int init_one_way_probability;
+    float init_walls_next_target_timeout;
+    float min_walls_next_target_timeout;
+    // Generate the course ahead on a thread of its own, the course is the same
+    bool generator_thread;
+  };
+  Simulation(const Settings & settings = Settings());
+  ~Simulation();
+  // Starts over in the menu, with every random draw coming from seed
+  void init(uint64_t seed);
+  // Advances the game by delta_time with keys as the Input key bitset
+  void update(float delta_time, unsigned int keys);
+  const Input & get_input() const;
+  uint64_t get_seed() const;
+  int get_status() const;
+  float get_score() const;
+  // Score the last run ended with, kept after game over clears the score
+  float get_last_score() const;
+  float get_time_to_start() const;
+  // Time spent playing in the current or last run
+  float get_play_time() const;
+  // Distance the camera has moved, lanes are in world coordinates and
+  // screen x is world x - scroll
+  float get_scroll() const;
+  // Scroll interpolated between the previous and the last update
+  float get_scroll(float alpha) const;
+  const std::vector<Lane> & get_lanes() const;
+  const Entities & get_entities() const;
+  const Player & get_player() const;
+  // Bit type is set if lanes[type] covers the whole player
+  unsigned int get_coverage() const;
+  // Hash of the state, to check that two runs are in the same state
+  uint64_t get_hash() const;
+  enum Status { MENU, READY, PLAYING, GAME_OVER, S_SIZE };
+
+  // Hooks for benchmarks and checks, the game does not use them
+  // Plays from now on at speed, the player moving at speed too
+  void start_playing(float speed);
+  // Empties the lanes but for one column at the left edge of the screen
+  void restart_lanes();
+  // Generates the course of one playing step, without moving
+  void generate_course(float delta_time);
+  // Erases the columns left of x
+  void erase_walls_before(float x);
+  // Height the columns of lane type move towards and the time left until
+  // the next target
+  void get_lane_target(int type, float & y, float & height, float & time_left) const;
+  float get_speed() const;
+  // Steps only the player, with keys as the Input key bitset
+  void update_player(float delta_time, unsigned int keys);
+  // Check if player is inside a wall of its type, and if swept, that it
+  // stayed inside over its whole move since the last step
+  bool player_inside(bool swept);
+private:
+  // Handler of the current status, a plain member pointer so that changing
+  // status does not allocate
+  void (Simulation::*status_update)(float);
+  void menu_update(float delta_time);
+  void ready_update(float delta_time);
+  void playing_update(float delta_time);
+  void game_over_update(float delta_time);
+  // Frees the player, lanes are kept for the next init
+  void clear();
+  // Different kinds of generation
+  void generate_game_walls(float delta_time);
+  void generate_ready_walls();
+  void generate_menu_walls();
+  void generate_walls();
+  CourseGenerator::Config get_course_config() const;
+  // Puts a blocker, gate or pickup at the end of a lane now and then
+  void spawn_entities(float delta_time);
+  // Columns the generators add to fill the screen after the last one
+  int get_missing_columns(const Lane & lane) const;
+  void erase_old_walls();
+  // Moves the world and camera back by rebase_distance, to keep the float
+  // precision of positions over long runs
+  void rebase();
+  Input input;
+  Random rng;
+  // Entities draw from their own generator, so they do not change courses
+  Random entity_rng;
+
+  // From settings
+  const int num_types;
+  const float walls_width;
+  const int lane_capacity;
+  const float start_speed;
+  const int walls_max_dist;
+  const int init_one_way_probability;
+  const float init_walls_next_target_timeout;
+  const float min_walls_next_target_timeout;
+
+  // Static members
+  const static float game_over_speed;
+  const static float ready_speed;
+  const static float walls_min_height;
+  const static int num_positions;
+  // Scroll at which the world moves back towards the origin
+  const static float rebase_distance;
+  const static int entity_capacity;
+  const static float spawn_interval;
+  const static float entity_size;
+  const static float pickup_score;
+
+  // speed
+  float speed;
+  float target_speed;
+  // Walls
+  float walls_next_target_timeout;
+  float walls_next_target_timer;
+  int max_distance;
+  int one_way_probability;
+  std::vector<int> walls_target;
+  std::vector<int> walls_next_target;
+  std::vector<int> walls_last_target;
+  std::vector<float> target_positions;
+  // Columns and difficulty while playing, declared after what it is made from
+  CourseGenerator course;
+  // Changed whenever the lanes or the motion change other than by a step of
+  // playing, which drops the course generated ahead
+  unsigned int course_generation;
+
+  Player* player;
+  std::vector<Lane> lanes;
+  Entities entities;
+  float spawn_timer;
+  // Distance the camera has moved
+  float scroll;
+  float last_scroll;
+
+  int status;
+  float time_to_start;
+  float score;
+  float last_score;
+  float play_time;
+  float total_time;
+};
+
+#endif  // SIMULATION_H
@@ -0,0 +1,52 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <cstdint>
+#include "utils.h"
+
+// Forward declarations
+class Simulation;
+class Lane;
+
+// Draws the game into an RGBA framebuffer in memory, with no window or GPU.
+// Rectangles cover the pixels whose centers they contain, as on the GPU.
+// Lanes are drawn a row at a time, eight pixels per step, and other
+// rectangles are filled or alpha blended four pixels at a time. The output
+// only depends on the simulation state, so it can be compared byte for byte.
+class SoftwareRenderer {
+public:
+  SoftwareRenderer(int width = SCREEN_WIDTH, int height = SCREEN_HEIGHT);
+  ~SoftwareRenderer();
+  // Draws lanes, entities, the player and a one line HUD of the simulation
+  void render(const Simulation & simulation);
+  void clear(const sf::Color & color);
+  // Fills the rectangle with color, blended by its alpha
+  void fill_rect(float left, float top, float right, float bottom, const sf::Color & color);
+  // Draws text with the built-in 5x7 font, each font pixel scale pixels wide.
+  // Lowercase letters are drawn as uppercase
+  void draw_text(float x, float y, const char * text, int scale, const sf::Color & color);
+  int get_width() const;
+  int get_height() const;
+  // Rows of RGBA bytes, top to bottom
+  const uint8_t * get_pixels() const;
+  // Hash of the pixels, for golden image checks
+  uint64_t get_hash() const;
+  // Writes the framebuffer to an image file, the format given by its extension
+  bool save(const std::string & path) const;
+private:
+  // Fills the framebuffer with background and the lanes blended over it with
+  // alpha 80. Each pixel is written once, with the color of the lanes covering it
+  void render_lanes(const std::vector<Lane> & lanes, float scroll, const sf::Color & background);
+  // Blends color over count pixels, or writes it if it is opaque
+  void fill_span(uint32_t * span, int count, const sf::Color & color);
+  int width;
+  int height;
+  std::vector<uint32_t> pixels;
+  // Per lane and pixel column, the rows the lane covers there
+  std::vector<int16_t> lane_tops;
+  std::vector<int16_t> lane_bottoms;
+  // Color of every set of lanes over the background, a bit per lane
+  std::vector<uint32_t> lane_colors;
+};
+
+#endif  // SOFTWARE_RENDERER_H
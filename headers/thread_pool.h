@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Each worker has its own deque: it takes its
+// newest task first and, when empty, steals the oldest task of another
+// worker. Tasks submitted from a worker go to that worker's deque.
+class ThreadPool {
+public:
+  ThreadPool(int num_threads);
+  // Waits for the pending tasks and stops the workers
+  ~ThreadPool();
+  void submit(const std::function<void()> & task);
+  // Blocks until every submitted task has run
+  void wait();
+  int size() const;
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+  void work(int index);
+  bool pop(int index, std::function<void()> & task);
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::atomic<int> queued;
+  std::atomic<int> pending;
+  std::atomic<unsigned int> next_queue;
+  bool stopping;
+};
+
+#endif  // THREAD_POOL_H
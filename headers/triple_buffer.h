@@ -0,0 +1,40 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Hands the latest value from one writer thread to one reader thread
+// without locks. The writer fills its slot and publishes it by swapping it
+// with the shared slot; the reader swaps the shared slot with its own when
+// it holds something newer. Neither side waits, and the reader always gets
+// the newest complete value, skipping the ones it was too slow for.
+template <typename T>
+class TripleBuffer {
+public:
+  TripleBuffer() : write_index(0), shared(1), read_index(2) {}
+  // Slot the writer fills before publishing it
+  T & get_write() {
+    return slots[write_index];
+  }
+  void publish() {
+    write_index = shared.exchange(write_index | fresh, std::memory_order_acq_rel) & index_mask;
+  }
+  // Takes the newest published slot, false if there is nothing new
+  bool acquire() {
+    if (!(shared.load(std::memory_order_relaxed) & fresh)) return false;
+    read_index = shared.exchange(read_index, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+  const T & get_read() const {
+    return slots[read_index];
+  }
+private:
+  // The shared index carries a flag for a slot not yet acquired
+  enum { index_mask = 3, fresh = 4 };
+  T slots[3];
+  unsigned int write_index;
+  std::atomic<unsigned int> shared;
+  unsigned int read_index;
+};
+
+#endif  // TRIPLE_BUFFER_H
@@ -11,6 +11,7 @@
 #include <sstream>
 #include <cmath>
 #include <fstream>
+#include <cstdint>
 
 // SFML
 #include <SFML/Window.hpp>
@@ -21,4 +22,8 @@ const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 480;
 const float EPSILON = 1e-6;
 
+// Sorts count times in nanoseconds and gives their median, 99th percentile
+// and max in milliseconds, all 0 if there are none
+void get_percentiles(int64_t * times, int count, float & p50, float & p99, float & max);
+
 #endif  // UTILS_H 
@@ -0,0 +1,46 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include "simulation.h"
+#include "lockstep.h"
+
+// A race against another instance over a Lockstep link. Each side steps
+// its own simulation and a copy of the other player's, both fed with the
+// keys the link delivers, so the other player can be shown as a ghost
+// without sending any state. Rounds start on both simulations in the same
+// step, when neither is playing and either player presses action, from a
+// seed of their own so both race the same course. Until then a player who
+// is done waits for the other one.
+class Versus {
+public:
+  Versus(Simulation & local, const Simulation::Settings & settings, Lockstep & lockstep);
+  ~Versus();
+  // Starts the copy of the other player's simulation from seed, which the
+  // local one must have been started from as well
+  void init(uint64_t seed);
+  // Whether the next step still needs the local keys read for it
+  bool needs_keys() const;
+  // Sends keys, used if needs_keys(), and waits up to timeout nanoseconds
+  // for the other side's keys of the next step. Returns whether it can run
+  bool wait(unsigned int keys, int64_t timeout);
+  // Steps both simulations, once wait returned true
+  void update(float delta_time);
+  const Simulation & get_opponent() const;
+  const Lockstep & get_lockstep() const;
+  // Rounds started, each from seed plus its number
+  int get_round() const;
+  // Writes a line on the rounds, the delays and whether the sides agree
+  void print(std::ostream & out) const;
+  // Identifies the runs that can race each other
+  static uint32_t get_session(uint64_t seed, int rate, const Simulation::Settings & settings);
+private:
+  Simulation & local;
+  Simulation opponent;
+  Lockstep & lockstep;
+  uint64_t seed;
+  int round;
+  float step_time;
+  bool reported_desync;
+};
+
+#endif  // VERSUS_H
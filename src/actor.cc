@@ -1,12 +1,12 @@
 #include "actor.h"
 
-Actor::Actor(Game & game, int type, float speed)
-  : game(game), type(type), speed(speed) {
+Actor::Actor(Simulation & simulation, int type, float speed)
+  : simulation(simulation), type(type), speed(speed) {
 }
 
 Actor::~Actor() {}
 
-int Actor::get_type() {
+int Actor::get_type() const {
   return type;
 }
 
@@ -18,8 +18,23 @@ void Actor::set_speed(float speed) {
   this->speed = speed;
 }
 
-const sf::Vector2f & Actor::get_pos() {
+const sf::Vector2f & Actor::get_pos() const {
   return pos;
 }
 
-std::vector<sf::Color> Actor::colors;
+sf::Vector2f Actor::get_pos(float alpha) const {
+  return last_pos + (pos - last_pos)*alpha;
+}
+
+void Actor::save_pos() {
+  last_pos = pos;
+}
+
+// One color per lane, the first two being the original game's red and blue.
+// Spelled out, as SFML's named colors may not be initialized before these
+std::vector<sf::Color> Actor::colors = {
+  sf::Color(255, 0, 0), sf::Color(0, 0, 255), sf::Color(0, 160, 0), sf::Color(255, 140, 0),
+  sf::Color(255, 0, 255), sf::Color(0, 170, 170), sf::Color(200, 180, 0),
+  sf::Color(120, 0, 180), sf::Color(140, 80, 20), sf::Color(255, 105, 180),
+  sf::Color(0, 110, 110), sf::Color(0, 0, 110), sf::Color(110, 110, 0),
+  sf::Color(110, 0, 0), sf::Color(100, 100, 100), sf::Color(120, 220, 0)};
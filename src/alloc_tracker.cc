@@ -0,0 +1,130 @@
+#include "alloc_tracker.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <execinfo.h>
+#include <unistd.h>
+
+namespace {
+
+const char * check_names[AllocTracker::C_SIZE] = { "off", "log", "abort" };
+
+// Plain zero-initialized values, usable before any constructor runs
+std::atomic<uint64_t> total_allocations(0);
+std::atomic<uint64_t> total_bytes(0);
+std::atomic<int> check_mode(AllocTracker::OFF);
+std::atomic<int> reports(0);
+thread_local uint64_t thread_allocations = 0;
+thread_local uint64_t thread_bytes = 0;
+thread_local bool guarded = false;
+thread_local bool reporting = false;
+
+// Writes straight to stderr, as anything buffered could allocate
+void report(std::size_t size) {
+  reporting = true;
+  int index = reports.fetch_add(1, std::memory_order_relaxed);
+  if (index < AllocTracker::max_reports) {
+    char message[128];
+    int length = snprintf(message, sizeof(message), "Allocation of %zu bytes in a guarded scope%s\n",
+                          size, index + 1 == AllocTracker::max_reports ? ", not reporting more" : "");
+    if (write(STDERR_FILENO, message, length) < 0) {}
+    void * frames[32];
+    backtrace_symbols_fd(frames, backtrace(frames, 32), STDERR_FILENO);
+  }
+  if (check_mode.load(std::memory_order_relaxed) == AllocTracker::ABORT) abort();
+  reporting = false;
+}
+
+void * allocate(std::size_t size) {
+  AllocTracker::record(size);
+  return malloc(size ? size : 1);
+}
+
+}  // namespace
+
+const int AllocTracker::max_reports;
+
+AllocTracker::Counts AllocTracker::get_counts() {
+  Counts counts = { total_allocations.load(std::memory_order_relaxed),
+                    total_bytes.load(std::memory_order_relaxed) };
+  return counts;
+}
+
+AllocTracker::Counts AllocTracker::get_thread_counts() {
+  Counts counts = { thread_allocations, thread_bytes };
+  return counts;
+}
+
+void AllocTracker::set_check(Check check) {
+  if (check != OFF) {
+    // The first backtrace loads the unwinder, which allocates
+    void * frame;
+    backtrace(&frame, 1);
+  }
+  check_mode.store(check, std::memory_order_relaxed);
+}
+
+const char * AllocTracker::get_name(Check check) {
+  return check_names[check];
+}
+
+AllocTracker::Check AllocTracker::get_check(const char * name) {
+  for (int check = 0; check < C_SIZE; ++check) {
+    if (strcmp(name, check_names[check]) == 0) return Check(check);
+  }
+  return C_SIZE;
+}
+
+void AllocTracker::record(std::size_t size) {
+  total_allocations.fetch_add(1, std::memory_order_relaxed);
+  total_bytes.fetch_add(size, std::memory_order_relaxed);
+  ++thread_allocations;
+  thread_bytes += size;
+  if (guarded and !reporting and check_mode.load(std::memory_order_relaxed) != OFF) report(size);
+}
+
+AllocGuard::AllocGuard(bool active) : previous(guarded) {
+  guarded = active;
+}
+
+AllocGuard::~AllocGuard() {
+  guarded = previous;
+}
+
+void * operator new(std::size_t size) {
+  void * p = allocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void * operator new[](std::size_t size) {
+  void * p = allocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void operator delete(void * p) noexcept {
+  free(p);
+}
+
+void operator delete[](void * p) noexcept {
+  free(p);
+}
+
+void operator delete(void * p, const std::nothrow_t &) noexcept {
+  free(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t &) noexcept {
+  free(p);
+}
@@ -0,0 +1,36 @@
+#include "assets.h"
+#include <cstring>
+
+// Embeds the file at path, relative to the directory make runs in, between
+// the symbols name_start and name_end. Every file here must also be listed
+// in ASSETS in the Makefile, so this object is rebuilt when one changes.
+// ELF only, as the rest of the build targets Linux.
+#define INCBIN(name, path) \
+  __asm__(".section .rodata\n" \
+          ".balign 16\n" \
+          ".global " #name "_start\n" \
+          #name "_start:\n" \
+          ".incbin \"" path "\"\n" \
+          ".global " #name "_end\n" \
+          #name "_end:\n" \
+          ".previous\n"); \
+  extern "C" const char name##_start[]; \
+  extern "C" const char name##_end[];
+
+INCBIN(kyc_font_audiowide, "fonts/Audiowide-Regular.ttf")
+
+namespace {
+
+const Assets::Asset assets[] = {
+  { "fonts/Audiowide-Regular.ttf", kyc_font_audiowide_start,
+    std::size_t(kyc_font_audiowide_end - kyc_font_audiowide_start) },
+};
+
+}  // namespace
+
+const Assets::Asset * Assets::find(const char * name) {
+  for (const Asset & asset : assets) {
+    if (strcmp(asset.name, name) == 0) return &asset;
+  }
+  return NULL;
+}
@@ -0,0 +1,41 @@
+#include "autopilot.h"
+
+const float Autopilot::look_ahead = 40.0f;
+const float Autopilot::margin = 4.0f;
+
+Autopilot::Autopilot() : last_keys(0) {}
+
+Autopilot::~Autopilot() {}
+
+unsigned int Autopilot::get_keys(const Simulation & simulation) {
+  unsigned int keys = 0;
+  int status = simulation.get_status();
+  if (status == Simulation::MENU or status == Simulation::GAME_OVER) {
+    keys = tap();
+  }
+  else if (status == Simulation::PLAYING) {
+    const Player & player = simulation.get_player();
+    const std::vector<Lane> & lanes = simulation.get_lanes();
+    sf::Vector2f pos = player.get_pos(), size = player.get_size();
+    const Lane & lane = lanes[player.get_type()];
+    int i = lane.get_index(simulation.get_scroll() + pos.x + size.x + look_ahead);
+    if (i >= 0) {
+      float center = lane.get_y(i) + lane.get_height(i)/2.0f;
+      float player_center = pos.y + size.y/2.0f;
+      if (center < player_center - margin) keys |= (1u<<Input::PLAYER_UP);
+      else if (center > player_center + margin) keys |= (1u<<Input::PLAYER_DOWN);
+
+      // Change to the next color if its lane covers the whole player now
+      int next = (player.get_type()+1) % lanes.size();
+      if (lane.get_height(i) < 1.5f*size.y and ((simulation.get_coverage() >> next) & 1)) {
+        keys |= tap();
+      }
+    }
+  }
+  last_keys = keys;
+  return keys;
+}
+
+unsigned int Autopilot::tap() {
+  return (last_keys & (1u<<Input::PLAYER_ACTION)) ? 0 : (1u<<Input::PLAYER_ACTION);
+}
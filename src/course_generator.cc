@@ -0,0 +1,383 @@
+#include "course_generator.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const int CourseGenerator::max_steps_ahead;
+const int CourseGenerator::column_screens;
+
+// With one hardware thread the two sides would only take turns, so the
+// steps are made inline instead
+CourseGenerator::CourseGenerator(const Config & config, bool threaded)
+  : config(config), threaded(threaded and std::thread::hardware_concurrency() > 1), generation(0),
+    delta_time(0.0f), started(false), steps(max_steps_ahead), steps_begin(0), steps_end(0), freed_steps(0),
+    active(false), idle(true), quitting(false), consumer_waiting(false), producer_waiting(false),
+    room_begin(0) {
+  // Rounded up to a power of two, as Lane does
+  int lane_size = 1;
+  while (lane_size < config.lane_capacity) lane_size <<= 1;
+  lane_mask = lane_size - 1;
+  column_capacity = 1;
+  while (column_capacity < unsigned(column_screens*lane_size)) column_capacity <<= 1;
+  column_mask = column_capacity - 1;
+  column_x.resize(config.num_types*column_capacity);
+  column_y.resize(config.num_types*column_capacity);
+  column_height.resize(config.num_types*column_capacity);
+  scratch_x.resize(lane_size);
+  scratch_y.resize(lane_size);
+  scratch_height.resize(lane_size);
+  for (int type = 0; type < Lane::max_lanes; ++type) {
+    read_columns[type] = write_columns[type] = freed_columns[type] = 0;
+  }
+  if (this->threaded) thread = std::thread(&CourseGenerator::run, this);
+}
+
+CourseGenerator::~CourseGenerator() {
+  stop();
+  if (threaded) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quitting = true;
+    }
+    wake.notify_one();
+    thread.join();
+  }
+}
+
+void CourseGenerator::take_step(unsigned int generation, float delta_time, State & state,
+                                std::vector<Lane> & lanes) {
+  if (!started or generation != this->generation or delta_time != this->delta_time) {
+    start(generation, delta_time, state, lanes);
+  }
+  const Step * step = &next_step();
+  if (step->state.speed != state.speed or step->state.scroll != state.scroll or
+      step->state.target_speed != state.target_speed) {
+    // The simulation moved otherwise than foreseen, which would put the
+    // course off the screen
+    start(generation, delta_time, state, lanes);
+    step = &next_step();
+  }
+
+  unsigned int begin = steps_begin.load(std::memory_order_relaxed);
+  for (int type = 0; type < config.num_types; ++type) {
+    Lane & lane = lanes[type];
+    const unsigned int base = type*column_capacity;
+    int count = step->counts[type];
+    while (count > 0) {
+      float *x, *y, *height;
+      int n = lane.get_back_segment(count, x, y, height);
+      for (int i = 0; i < n; ++i) {
+        unsigned int slot = base + ((read_columns[type] + i) & column_mask);
+        x[i] = column_x[slot];
+        y[i] = column_y[slot];
+        height[i] = column_height[slot];
+      }
+      lane.commit_back(n);
+      read_columns[type] += n;
+      count -= n;
+    }
+  }
+  state = step->state;
+  // The producer may reuse the step and its columns from here on
+  steps_begin.store(begin + 1);
+  if (producer_waiting.load() and begin + 1 == room_begin.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(mutex);
+    room.notify_one();
+  }
+}
+
+void CourseGenerator::stop() {
+  if (!started) return;
+  started = false;
+  if (!threaded) return;
+  std::unique_lock<std::mutex> lock(mutex);
+  active.store(false, std::memory_order_relaxed);
+  room.notify_one();
+  stopped.wait(lock, [this] { return idle; });
+}
+
+bool CourseGenerator::is_threaded() const {
+  return threaded;
+}
+
+bool CourseGenerator::move(float delta_time, float target_speed, float rebase_distance, float & speed,
+                           float & scroll) {
+  speed += (target_speed - speed)*delta_time*10.0f;
+  scroll += delta_time*speed;
+  return scroll >= rebase_distance;
+}
+
+void CourseGenerator::speed_up(float delta_time, float & target_speed) {
+  target_speed += delta_time*10.0f;
+}
+
+void CourseGenerator::fill_linear(float * out, int count, float start, float step) {
+  int k = 0;
+#ifdef __SSE2__
+  const __m128 base = _mm_set1_ps(start), steps = _mm_set1_ps(step);
+  __m128 index = _mm_setr_ps(1.0f, 2.0f, 3.0f, 4.0f);
+  for (; k + 4 <= count; k += 4) {
+    _mm_storeu_ps(out + k, _mm_add_ps(base, _mm_mul_ps(index, steps)));
+    index = _mm_add_ps(index, _mm_set1_ps(4.0f));
+  }
+#endif
+  for (; k < count; ++k) {
+    out[k] = start + (k+1)*step;
+  }
+}
+
+void CourseGenerator::fill_smoothed(float * out, int count, float start, float target, float ratio) {
+  float diff = start - target;
+  float power = ratio;
+  int k = 0;
+#ifdef __SSE2__
+  float ratio2 = ratio*ratio;
+  __m128 powers = _mm_setr_ps(ratio, ratio2, ratio2*ratio, ratio2*ratio2);
+  const __m128 step = _mm_set1_ps(ratio2*ratio2);
+  const __m128 targets = _mm_set1_ps(target), diffs = _mm_set1_ps(diff);
+  for (; k + 4 <= count; k += 4) {
+    _mm_storeu_ps(out + k, _mm_add_ps(targets, _mm_mul_ps(diffs, powers)));
+    powers = _mm_mul_ps(powers, step);
+  }
+  power = _mm_cvtss_f32(powers);
+#endif
+  for (; k < count; ++k) {
+    out[k] = target + diff*power;
+    power *= ratio;
+  }
+}
+
+void CourseGenerator::start(unsigned int generation, float delta_time, const State & state,
+                            const std::vector<Lane> & lanes) {
+  stop();
+  // The producer is idle, so its side can be written from here
+  this->generation = generation;
+  this->delta_time = delta_time;
+  this->state = state;
+  for (int type = 0; type < config.num_types; ++type) {
+    const Lane & lane = lanes[type];
+    Tail & tail = tails[type];
+    tail.empty = lane.empty();
+    int last = lane.size()-1;
+    tail.x = tail.empty ? 0.0f : lane.get_x(last);
+    tail.y = tail.empty ? 0.0f : lane.get_y(last);
+    tail.height = tail.empty ? 0.0f : lane.get_height(last);
+    tail.end = lane.get_end();
+    read_columns[type] = write_columns[type] = freed_columns[type] = 0;
+  }
+  freed_steps = 0;
+  steps_begin.store(0, std::memory_order_relaxed);
+  steps_end.store(0, std::memory_order_relaxed);
+  started = true;
+  if (threaded) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      active.store(true, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+  }
+}
+
+const CourseGenerator::Step & CourseGenerator::next_step() {
+  unsigned int begin = steps_begin.load(std::memory_order_relaxed);
+  if (!threaded) {
+    produce();
+  }
+  else if (steps_end.load(std::memory_order_acquire) == begin) {
+    // Mostly right after starting, the producer is ahead otherwise
+    std::unique_lock<std::mutex> lock(mutex);
+    consumer_waiting.store(true);
+    filled.wait(lock, [this, begin] { return steps_end.load() != begin; });
+    consumer_waiting.store(false, std::memory_order_relaxed);
+  }
+  return steps[begin % max_steps_ahead];
+}
+
+bool CourseGenerator::produce() {
+  unsigned int end = steps_end.load(std::memory_order_relaxed);
+  update_freed();
+  if (end - freed_steps >= unsigned(max_steps_ahead)) {
+    // Full, wait for half of it to be taken so the threads rarely meet
+    if (!wait_for_room(end - max_steps_ahead/2)) return false;
+  }
+
+  const int num_types = config.num_types;
+  const int num_positions = config.target_positions.size();
+  State & s = state;
+  s.walls_next_target_timer -= delta_time;
+  // Timeout to change target
+  if (s.walls_next_target_timer < 0) {
+    // Increase difficulty
+    s.walls_next_target_timer = s.walls_next_target_timeout;
+    s.walls_next_target_timeout = std::max(config.min_walls_next_target_timeout, s.walls_next_target_timeout*0.95f);
+    s.one_way_probability = std::min(100, s.one_way_probability+2);
+
+    // Update target and check if now there is only one path
+    bool one_path = false;
+    for (int type = 0; type < num_types; ++type) {
+      s.walls_last_target[type] = s.walls_target[type];
+      s.walls_target[type] = s.walls_next_target[type];
+      s.walls_next_target[type] = s.rng.next(num_positions);
+      if (s.walls_last_target[type] < 0 or s.walls_target[type] < 0) one_path = true;
+    }
+
+    // Join now to make next target only one path
+    bool join = (s.rng.next(100) < s.one_way_probability);
+    if (!one_path and join) {
+      int pos = 0;
+      for (int type = 0; type < num_types; ++type) {
+        pos += abs(s.walls_last_target[type]);
+      }
+      pos /= num_types;
+      for (int type = 0; type < num_types; ++type) {
+        s.walls_target[type] = pos;
+      }
+      for (int type = 0; type < num_types; ++type) {
+        s.walls_next_target[type] = -(1 + s.rng.next(num_positions-1));  // Close path in random position
+      }
+      // Type that will survive, assign it a random position
+      int survive = s.rng.next(num_types);
+      s.walls_next_target[survive] = s.rng.next(num_positions);
+    }
+
+    // Limit next target by walls_max_dist
+    for (int type = 0; type < num_types; ++type) {
+      // Check the distance even if there is a negative target
+      if (s.walls_next_target[type] >= 0) {
+        s.walls_next_target[type] = s.rng.next(num_positions);
+        if (std::abs(std::abs(s.walls_target[type])-s.walls_next_target[type] > config.walls_max_dist)) {
+          if (std::abs(s.walls_target[type]) > s.walls_next_target[type]) {
+            s.walls_next_target[type] = std::abs(s.walls_target[type]) - config.walls_max_dist;
+          }
+          else {
+            s.walls_next_target[type] = std::abs(s.walls_target[type]) + config.walls_max_dist;
+          }
+        }
+      }
+    }
+  }
+
+  Step & step = steps[end % max_steps_ahead];
+  for (int type = 0; type < num_types; ++type) {
+    Tail & tail = tails[type];
+    int written = 0;
+    if (tail.empty) {
+      scratch_x[0] = s.scroll + SCREEN_WIDTH;
+      scratch_y[0] = std::fmod(150.0f*(type+1), float(SCREEN_HEIGHT));
+      scratch_height[0] = 0.0f;
+      if (!push_columns(type, 1)) return false;
+      tail.x = scratch_x[0];
+      tail.y = scratch_y[0];
+      tail.height = scratch_height[0];
+      tail.empty = false;
+      ++tail.end;
+      ++written;
+    }
+
+    float time_left = s.walls_next_target_timer;
+    int target_ind = std::abs(s.walls_target[type]);  // Abs to send closed paths to its position
+    // Smooth over the time each column takes to scroll by, not the step,
+    // so the course does not depend on the simulation rate
+    float column_time = config.walls_width/s.speed;
+    float factor = std::max(1.0f, 3.0f*(1-time_left));
+    float target_height = s.walls_target[type] < 0 ? 0.0f : config.walls_min_height;
+
+    // Every column steps towards the same targets at the same rate, so a
+    // chunk is written at once in closed form. Chunks end where the lane's
+    // ring wraps, as they would writing to the lane
+    int count = get_missing_columns(tail);
+    while (count > 0) {
+      int n = std::min(count, lane_mask + 1 - int(tail.end & lane_mask));
+      fill_linear(&scratch_x[0], n, tail.x, config.walls_width);
+      fill_smoothed(&scratch_y[0], n, tail.y, config.target_positions[target_ind], 1.0f - column_time*factor);
+      fill_smoothed(&scratch_height[0], n, tail.height, target_height, 1.0f - column_time);
+      if (!push_columns(type, n)) return false;
+      tail.x = scratch_x[n-1];
+      tail.y = scratch_y[n-1];
+      tail.height = scratch_height[n-1];
+      tail.end += n;
+      written += n;
+      count -= n;
+    }
+    step.counts[type] = written;
+  }
+  step.state = s;
+  steps_end.store(end + 1);
+  if (consumer_waiting.load()) {
+    std::lock_guard<std::mutex> lock(mutex);
+    filled.notify_one();
+  }
+
+  // Move on as the simulation does between generating two steps
+  speed_up(delta_time, s.target_speed);
+  if (move(delta_time, s.target_speed, config.rebase_distance, s.speed, s.scroll)) {
+    s.scroll -= config.rebase_distance;
+    for (int type = 0; type < num_types; ++type) {
+      tails[type].x += -config.rebase_distance;
+    }
+  }
+  return true;
+}
+
+bool CourseGenerator::push_columns(int type, int count) {
+  update_freed();
+  while (column_capacity - (write_columns[type] - freed_columns[type]) < unsigned(count)) {
+    if (!wait_for_room(freed_steps + 1)) return false;
+  }
+  const unsigned int base = type*column_capacity;
+  for (int i = 0; i < count; ++i) {
+    unsigned int slot = base + ((write_columns[type] + i) & column_mask);
+    column_x[slot] = scratch_x[i];
+    column_y[slot] = scratch_y[i];
+    column_height[slot] = scratch_height[i];
+  }
+  write_columns[type] += count;
+  return true;
+}
+
+bool CourseGenerator::wait_for_room(unsigned int begin) {
+  // Without a thread the consumer took every step, there is always room
+  if (!threaded) return false;
+  std::unique_lock<std::mutex> lock(mutex);
+  room_begin.store(begin, std::memory_order_relaxed);
+  producer_waiting.store(true);
+  room.wait(lock, [this, begin] {
+    return !active.load(std::memory_order_relaxed) or int(steps_begin.load() - begin) >= 0;
+  });
+  producer_waiting.store(false, std::memory_order_relaxed);
+  lock.unlock();
+  update_freed();
+  return active.load(std::memory_order_relaxed);
+}
+
+void CourseGenerator::update_freed() {
+  unsigned int begin = steps_begin.load(std::memory_order_acquire);
+  for (; freed_steps != begin; ++freed_steps) {
+    const Step & step = steps[freed_steps % max_steps_ahead];
+    for (int type = 0; type < config.num_types; ++type) {
+      freed_columns[type] += step.counts[type];
+    }
+  }
+}
+
+int CourseGenerator::get_missing_columns(const Tail & tail) const {
+  // Columns follow the last one until one starts past the screen's right edge
+  float first_x = tail.x + config.walls_width;
+  float right = state.scroll + SCREEN_WIDTH;
+  if (first_x >= right) return 0;
+  return int(std::ceil((right - first_x)/config.walls_width));
+}
+
+void CourseGenerator::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return quitting or active.load(std::memory_order_relaxed); });
+    if (quitting) break;
+    idle = false;
+    lock.unlock();
+    while (active.load(std::memory_order_relaxed) and produce()) {}
+    lock.lock();
+    idle = true;
+    stopped.notify_all();
+  }
+}
@@ -0,0 +1,200 @@
+#include "entities.h"
+#include "actor.h"
+
+Entities::Entities(int capacity) : slots(capacity), free_slots(capacity) {
+  for (Group & group : groups) {
+    group.x.resize(capacity);
+    group.y.resize(capacity);
+    group.width.resize(capacity);
+    group.height.resize(capacity);
+    group.type.resize(capacity);
+    group.speed.resize(capacity);
+    group.min_y.resize(capacity);
+    group.max_y.resize(capacity);
+    group.slot.resize(capacity);
+  }
+  for (Slot & slot : slots) {
+    slot.generation = 0;
+    slot.kind = K_SIZE;
+  }
+  clear();
+}
+
+Entities::~Entities() {}
+
+Entities & Entities::operator=(const Entities & other) {
+  if (this == &other) return *this;
+  if (capacity() != other.capacity()) {
+    Entities sized(other.capacity());
+    std::swap(groups, sized.groups);
+    std::swap(slots, sized.slots);
+    std::swap(free_slots, sized.free_slots);
+    free_count = sized.free_count;
+  }
+  for (int kind = 0; kind < K_SIZE; ++kind) {
+    const Group & from = other.groups[kind];
+    Group & to = groups[kind];
+    int n = to.count = from.count;
+    std::copy(from.x.begin(), from.x.begin() + n, to.x.begin());
+    std::copy(from.y.begin(), from.y.begin() + n, to.y.begin());
+    std::copy(from.width.begin(), from.width.begin() + n, to.width.begin());
+    std::copy(from.height.begin(), from.height.begin() + n, to.height.begin());
+    std::copy(from.type.begin(), from.type.begin() + n, to.type.begin());
+    std::copy(from.speed.begin(), from.speed.begin() + n, to.speed.begin());
+    std::copy(from.min_y.begin(), from.min_y.begin() + n, to.min_y.begin());
+    std::copy(from.max_y.begin(), from.max_y.begin() + n, to.max_y.begin());
+    std::copy(from.slot.begin(), from.slot.begin() + n, to.slot.begin());
+  }
+  return *this;
+}
+
+void Entities::clear() {
+  for (Group & group : groups) {
+    group.count = 0;
+  }
+  // Hand out low slots first
+  int n = capacity();
+  for (int i = 0; i < n; ++i) {
+    if (slots[i].kind != K_SIZE) ++slots[i].generation;
+    slots[i].kind = K_SIZE;
+    free_slots[i] = n-1-i;
+  }
+  free_count = n;
+}
+
+Entities::Handle Entities::spawn(Kind kind, int type, float x, float y, float width, float height) {
+  if (free_count == 0) {
+    Handle none = { uint32_t(capacity()), 0 };
+    return none;
+  }
+  uint32_t index = free_slots[--free_count];
+  Group & group = groups[kind];
+  int i = group.count++;
+  group.x[i] = x;
+  group.y[i] = y;
+  group.width[i] = width;
+  group.height[i] = height;
+  group.type[i] = type;
+  group.speed[i] = 0.0f;
+  group.min_y[i] = group.max_y[i] = y;
+  group.slot[i] = index;
+  slots[index].kind = kind;
+  slots[index].index = i;
+  Handle handle = { index, slots[index].generation };
+  return handle;
+}
+
+void Entities::set_motion(Handle handle, float speed, float min_y, float max_y) {
+  if (!is_alive(handle)) return;
+  const Slot & slot = slots[handle.index];
+  Group & group = groups[slot.kind];
+  group.speed[slot.index] = speed;
+  group.min_y[slot.index] = min_y;
+  group.max_y[slot.index] = max_y;
+}
+
+bool Entities::is_alive(Handle handle) const {
+  return handle.index < slots.size() and slots[handle.index].kind != K_SIZE and
+         slots[handle.index].generation == handle.generation;
+}
+
+void Entities::destroy(Handle handle) {
+  if (!is_alive(handle)) return;
+  remove(slots[handle.index].kind, slots[handle.index].index);
+}
+
+int Entities::size() const {
+  int count = 0;
+  for (const Group & group : groups) {
+    count += group.count;
+  }
+  return count;
+}
+
+int Entities::capacity() const {
+  return slots.size();
+}
+
+const Entities::Group & Entities::get_group(Kind kind) const {
+  return groups[kind];
+}
+
+void Entities::update(float delta_time, float left) {
+  Group & blockers = groups[BLOCKER];
+  for (int i = 0; i < blockers.count; ++i) {
+    float y = blockers.y[i] + blockers.speed[i]*delta_time;
+    // Bounce off both ends of the range
+    if (y < blockers.min_y[i] or y > blockers.max_y[i]) {
+      blockers.speed[i] = -blockers.speed[i];
+      y = std::max(blockers.min_y[i], std::min(blockers.max_y[i], y));
+    }
+    blockers.y[i] = y;
+  }
+  for (int kind = 0; kind < K_SIZE; ++kind) {
+    Group & group = groups[kind];
+    // Going backwards, the entity moved into a removed one's place is done
+    for (int i = group.count-1; i >= 0; --i) {
+      if (group.x[i] + group.width[i] <= left) remove(kind, i);
+    }
+  }
+}
+
+Entities::Hits Entities::collide(const sf::Vector2f & pos, const sf::Vector2f & size) {
+  Hits hits = { false, -1, 0 };
+  for (int kind = 0; kind < K_SIZE; ++kind) {
+    Group & group = groups[kind];
+    for (int i = group.count-1; i >= 0; --i) {
+      if (group.x[i] > pos.x + size.x or group.x[i] + group.width[i] < pos.x or
+          group.y[i] > pos.y + size.y or group.y[i] + group.height[i] < pos.y) {
+        continue;
+      }
+      if (kind == BLOCKER) {
+        hits.blocked = true;
+      }
+      else if (kind == GATE) {
+        hits.gate_type = group.type[i];
+      }
+      else {
+        ++hits.pickups;
+        remove(kind, i);
+      }
+    }
+  }
+  return hits;
+}
+
+void Entities::shift(float dx) {
+  for (Group & group : groups) {
+    for (int i = 0; i < group.count; ++i) {
+      group.x[i] += dx;
+    }
+  }
+}
+
+sf::Color Entities::get_color(Kind kind, int type) {
+  if (kind == GATE) return Actor::colors[type];
+  if (kind == PICKUP) return sf::Color(255, 200, 0);
+  return sf::Color(40, 40, 40);
+}
+
+void Entities::remove(int kind, int index) {
+  Group & group = groups[kind];
+  uint32_t slot = group.slot[index];
+  ++slots[slot].generation;
+  slots[slot].kind = K_SIZE;
+  free_slots[free_count++] = slot;
+
+  int last = --group.count;
+  if (index != last) {
+    group.x[index] = group.x[last];
+    group.y[index] = group.y[last];
+    group.width[index] = group.width[last];
+    group.height[index] = group.height[last];
+    group.type[index] = group.type[last];
+    group.speed[index] = group.speed[last];
+    group.min_y[index] = group.min_y[last];
+    group.max_y[index] = group.max_y[last];
+    group.slot[index] = group.slot[last];
+    slots[group.slot[index]].index = index;
+  }
+}
@@ -0,0 +1,88 @@
+#include "frame_pacer.h"
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+const char * mode_names[FramePacer::M_SIZE] = { "vsync", "low-latency", "cap" };
+
+}  // namespace
+
+const int FramePacer::num_latencies;
+const int64_t FramePacer::spin_time = 2000000;
+const int64_t FramePacer::margin = 500000;
+
+FramePacer::FramePacer()
+  : mode(VSYNC), period(0), deadline(0), frame_start(0), work_estimate(0),
+    latencies(num_latencies), latency_count(0) {
+}
+
+FramePacer::~FramePacer() {}
+
+void FramePacer::set_mode(Mode mode, float rate) {
+  this->mode = mode;
+  period = int64_t(1e9/rate);
+  deadline = Profiler::now() + period;
+}
+
+FramePacer::Mode FramePacer::get_mode() const {
+  return mode;
+}
+
+bool FramePacer::uses_vsync() const {
+  return mode == VSYNC;
+}
+
+void FramePacer::begin_frame() {
+  if (mode == LOW_LATENCY) wait_until(deadline - work_estimate - margin);
+  frame_start = Profiler::now();
+}
+
+void FramePacer::end_frame() {
+  int64_t work = Profiler::now() - frame_start;
+  work_estimate = std::max(work, work_estimate - (work_estimate - work)/16);
+  if (mode == VSYNC) return;
+  if (mode == CAP) wait_until(deadline);
+  deadline += period;
+  // After a missed deadline aim at the next one instead of rushing frames
+  int64_t now = Profiler::now();
+  if (deadline < now) deadline = now + period;
+}
+
+void FramePacer::add_latency(int64_t event_time, int64_t present_time) {
+  latencies[latency_count++ % num_latencies] = present_time - event_time;
+}
+
+Profiler::Stats FramePacer::get_latency() const {
+  Profiler::Stats stats = { 0.0f, 0.0f, 0.0f };
+  int count = std::min(latency_count, num_latencies);
+  if (count == 0) return stats;
+  std::vector<int64_t> times(latencies.begin(), latencies.begin() + count);
+  get_percentiles(&times[0], count, stats.p50, stats.p99, stats.max);
+  return stats;
+}
+
+int FramePacer::get_latency_count() const {
+  return latency_count;
+}
+
+const char * FramePacer::get_name(Mode mode) {
+  return mode_names[mode];
+}
+
+FramePacer::Mode FramePacer::get_mode(const char * name) {
+  for (int mode = 0; mode < M_SIZE; ++mode) {
+    if (strcmp(name, mode_names[mode]) == 0) return Mode(mode);
+  }
+  return M_SIZE;
+}
+
+void FramePacer::wait_until(int64_t time) {
+  for (int64_t left = time - Profiler::now(); left > spin_time; left = time - Profiler::now()) {
+    std::this_thread::sleep_for(std::chrono::nanoseconds(left - spin_time));
+  }
+  while (Profiler::now() < time) {
+    std::this_thread::yield();
+  }
+}
@@ -1,426 +1,400 @@
 #include "game.h"
-#include "wall.h"
 #include "utils.h"
-#include "player.h"
+#include "profiler.h"
+#include <ctime>
 #include <iostream>
 
-const int Game::num_types = 2;
-const int Game::num_positions = 8;
-const int Game::walls_max_dist = 3;
-const float Game::walls_width = 4.0f;
-const float Game::start_speed = 300.0f;
-const float Game::ready_speed = 1000.0f;
-const float Game::game_over_speed = 200.0f;
-const float Game::walls_min_height = 180.0f; 
-const int Game::init_one_way_probability = 20;
-const float Game::min_walls_next_target_timeout = 0.5f;
-const float Game::init_walls_next_target_timeout = 2.0f;
+const int Game::default_rate = 240;
+const float Game::max_frame_time = 0.1f;
+const int Game::max_key_events;
 
-Game::Game(int width, int height, std::string title, int style)
-  : window(sf::VideoMode(width, height), title, style) {
+Snapshot::Snapshot()
+  : entities(0), scroll(0.0f), last_scroll(0.0f), player_type(0), ghost_visible(false), ghost_type(0),
+    status(Simulation::MENU), score(0),
+    timeout(0), show_profiler(false), profiler_stats(), profiler_allocs(), alpha(0.0f), time(0), input_time(0) {
+}
+
+Game::Game(int width, int height, std::string title, int style,
+           const Simulation::Settings & settings)
+  : window(sf::VideoMode(width, height), title, style), settings(settings), simulation(settings),
+    entity_vertices(sf::Quads), player_vertices(sf::Quads, 4),
+    ghost_vertices(sf::Quads, 4) {
   
   window.setMouseCursorVisible(false);
   window.setVerticalSyncEnabled(true);
-
-  sf::RenderStates(BlendMultiply);
-
-  input = Input();
-  gui = new Gui(*this);
-
-  one_way_probability = init_one_way_probability;
-  status = MENU;
-  score = 0;
-  total_time = 0;
-  time_to_start = 0;
+  // Held keys are one press, key repeats would only fill the event queue
+  window.setKeyRepeatEnabled(false);
+
+  last_status = Simulation::MENU;
+  hud_score = 0;
+  hud_timeout = 0;
+  show_profiler = false;
+  drawn_status = Simulation::MENU;
+  step_time = 1.0f/default_rate;
+  replay = NULL;
+  recorder = NULL;
+  versus = NULL;
+  threaded = false;
+  running = false;
+  key_events_begin = key_events_end = 0;
+  keys_down = 0;
+  event_time = 0;
+  input_time = 0;
+  presented_input_time = 0;
+  start_time = 0;
+  init_time = 0;
 }
 
 Game::~Game() {
-  clear();
+  delete versus;
 }
 
-bool Game::init() {
-  if (!gui->init()) return false;
-  speed = target_speed = start_speed;
-
-  all_walls = std::vector<std::list<Wall*>>(num_types);
-
-  walls_next_target_timeout = init_walls_next_target_timeout;
-  walls_next_target_timer = walls_next_target_timeout;
-  walls_last_target = walls_target = walls_next_target = std::vector<int>(num_types);
-  
-  for (int type = 0; type < num_types; ++type) {
-    walls_target[type] = walls_next_target[type] =  rand()%num_positions;
+bool Game::init(uint64_t seed) {
+  if (!gui.init()) return false;
+  if (!scores.open("scores")) return false;
+  gui.set_best_score(scores.get_best_score());
+  Profiler::instance().set_enabled(true);
+  simulation.init(seed);
+  if (versus) versus->init(seed);
+  gui.set_seed(seed);
+  last_status = drawn_status = simulation.get_status();
+
+  lane_renderers.clear();
+  for (const Lane & lane : simulation.get_lanes()) {
+    lane_renderers.push_back(LaneRenderer(lane));
   }
-  
-  target_positions = std::vector<float> { 0.0f, 
-                                          50.0f, 
-                                          100.0f,
-                                          150.0f,
-                                          200.0f,
-                                          250.0f,
-                                          300.0f,
-                                          350.0f };
-                                          
-  Actor::colors = {sf::Color::Red, sf::Color::Blue}; 
-  player = (new Player(*this, 0, 1000.0f));
-
-  // Assign initial status update, which is menu_update
-  status_update = std::bind(&Game::menu_update, this, std::placeholders::_1);
-
+  publish(0.0f);
+  init_time = Profiler::now();
   return true;
 }
 
 void Game::run() {
-  srand(time(0));
-  sf::Clock clock;
-  while (window.isOpen()) {
-    float delta_time = clock.restart().asSeconds();
-    process_events();
-    if (window.isOpen()) {
-      update(delta_time);
-      render();
+  Profiler & profiler = Profiler::instance();
+  int64_t last_time = Profiler::now();
+  float accumulator = 0.0f;
+  running = true;
+  if (threaded) {
+    // The window's context can only be active in one thread at a time
+    window.setActive(false);
+    render_thread = std::thread(&Game::render_loop, this);
+  }
+  while (running) {
+    profiler.begin_frame();
+    ProfileZone frame_zone(Profiler::FRAME);
+    if (!threaded) pacer.begin_frame();
+    {
+      ProfileZone zone(Profiler::EVENTS);
+      process_events();
     }
+    if (!running) break;
+    // Read after the events, so every event queued is older than now
+    int64_t now = Profiler::now();
+    accumulator += std::min((now - last_time)*1e-9f, max_frame_time);
+    last_time = now;
+    {
+      ProfileZone zone(Profiler::UPDATE);
+      // The pending steps end at now - accumulator plus whole steps, each
+      // one takes the key events up to its end
+      int64_t step_end = now - int64_t(accumulator*1e9f);
+      while (accumulator >= step_time) {
+        int64_t end = step_end + int64_t(step_time*1e9f);
+        if (versus) {
+          // Keys are read once per step, which may wait over several frames
+          unsigned int keys = versus->needs_keys() ? take_keys(end) : 0;
+          if (!versus->wait(keys, int64_t(step_time*1e9f))) {
+            // The other side is behind, draw meanwhile without piling up steps
+            accumulator = std::min(accumulator, step_time);
+            break;
+          }
+          AllocGuard guard(simulation.get_status() == Simulation::PLAYING);
+          versus->update(step_time);
+        }
+        else {
+          unsigned int keys = take_keys(end);
+          unsigned int step_keys = keys;
+          if (replay and !replay->next(step_keys)) {
+            replay = NULL;
+            step_keys = keys;
+          }
+          if (recorder) recorder->record(step_keys);
+          // Steady play must not allocate, changes of status may
+          AllocGuard guard(simulation.get_status() == Simulation::PLAYING);
+          simulation.update(step_time, step_keys);
+        }
+        step_end = end;
+        update_hud();
+        accumulator -= step_time;
+        // Keep the older input until it is displayed, one sample at a time
+        if (event_time and input_time <= presented_input_time) {
+          input_time = event_time;
+          event_time = 0;
+        }
+      }
+      AllocGuard guard(last_status == Simulation::PLAYING);
+      publish(accumulator/step_time);
+    }
+    if (threaded) {
+      // Wake up for the next step, drawing happens meanwhile
+      sf::sleep(sf::seconds(step_time - accumulator));
+    }
+    else {
+      // The profiler has a single writer, so only this thread's drawing is profiled
+      ProfileZone zone(Profiler::RENDER);
+      draw();
+      pacer.end_frame();
+    }
+  }
+  if (threaded) {
+    render_thread.join();
+    window.setActive(true);
+  }
+  window.close();
+  if (pacer.get_latency_count() > 0) {
+    Profiler::Stats latency = pacer.get_latency();
+    std::cout << "Input to display latency (" << FramePacer::get_name(pacer.get_mode()) << "): p50 "
+              << latency.p50 << " ms, p99 " << latency.p99 << " ms, max " << latency.max << " ms over "
+              << pacer.get_latency_count() << " inputs" << std::endl;
   }
+  if (versus) versus->print(std::cout);
 }
 
-sf::RenderWindow & Game::get_window() {
-  return window;
+void Game::set_rate(int rate) {
+  step_time = 1.0f/rate;
 }
 
-const Input & Game::get_input() {
-  return input;
+void Game::set_replay(Replay * replay) {
+  this->replay = replay;
 }
 
-void Game::update(float delta_time) {
-  input.update();
-  // Update speed to target
-  speed += (target_speed - speed)*delta_time*10.0f;
-  total_time += delta_time;
-
-  // Update existing walls
-  for (std::list<Wall*> & walls : all_walls) {
-    for (Wall * wall : walls) {
-      wall->set_speed(speed);
-      wall->update(delta_time);
-    }
-  }
-
-  // Delete old walls
-  erase_old_walls();
-  // Update specific for current status
-  status_update(delta_time);
+void Game::set_recorder(Recorder * recorder) {
+  this->recorder = recorder;
 }
 
-//** STATUS DEPENDENT UPDATE **
-void Game::menu_update(float delta_time) {
-  generate_menu_walls();
-
-  gui->update();
-  if (input.key_pressed(input.Key::PLAYER_ACTION)) {
-      status = READY;
-      status_update = std::bind(&Game::ready_update, this, std::placeholders::_1);
-      gui->set_status(status);
-      time_to_start = 3.0f;
-  }
+void Game::set_lockstep(Lockstep * lockstep) {
+  delete versus;
+  versus = lockstep ? new Versus(simulation, settings, *lockstep) : NULL;
 }
 
-void Game::ready_update(float delta_time) {
-  generate_ready_walls();
-
-  if (player->get_type() != 0) player->set_type(0);
-  target_speed = ready_speed;
-  if (time_to_start < 2.5f) {
-    target_speed = start_speed;
-    one_way_probability = init_one_way_probability;
-    walls_next_target_timeout = init_walls_next_target_timeout;
-    for (int type = 0; type < num_types; ++type) {
-      walls_target[type] = walls_next_target[type] = rand()%num_positions;
-    }
-  }
-
-  // Move player to initial position
-  sf::Vector2f pos = player->get_pos();
-  sf::Vector2f size = player->get_size();
-  player->set_pos(sf::Vector2f(pos.x,
-                               pos.y + ((SCREEN_HEIGHT/2.0f-size.y/2.0) - pos.y)*delta_time*2));
-
-  // Adjust speed
-  time_to_start -= delta_time;
-  gui->set_timeout(time_to_start+1);
-  if (time_to_start < 0.0f) {
-    status = PLAYING;
-    status_update = std::bind(&Game::playing_update, this, std::placeholders::_1);
-    gui->set_status(status);
-  }
+void Game::set_render_thread(bool render_thread) {
+  threaded = render_thread;
 }
 
-void Game::playing_update(float delta_time) {
-  generate_game_walls(delta_time);
-
-  score += delta_time*100;
-  target_speed += delta_time*10.0f;
-  gui->set_score(score);
-
-  player->update(delta_time);
-  if (!player_inside()) {
-    status = GAME_OVER;
-    gui->set_status(status);
-    status_update = std::bind(&Game::game_over_update, this, std::placeholders::_1);
-    target_speed = game_over_speed;
-  } 
+void Game::set_pacing(FramePacer::Mode mode, float rate) {
+  pacer.set_mode(mode, rate);
+  window.setVerticalSyncEnabled(pacer.uses_vsync());
 }
 
-void Game::game_over_update(float delta_time) {
-  generate_walls();
-  score = 0;
-  if (input.key_pressed(input.Key::PLAYER_ACTION)) {
-    status = READY;
-    status_update = std::bind(&Game::ready_update, this, std::placeholders::_1);
-    gui->set_status(status);
-    time_to_start = 3.0f;
-  }
+void Game::set_start_time(int64_t time) {
+  start_time = time;
 }
-//** END STATUS DEPENDENT UPDATE
 
 void Game::process_events() {
   sf::Event event;
   while (window.pollEvent(event)) {
-    if (event.type == sf::Event::Closed or sf::Keyboard::isKeyPressed(sf::Keyboard::Escape)) {
-      gui->save_score();
-      window.close();
+    bool pressed = (event.type == sf::Event::KeyPressed);
+    if (event.type == sf::Event::Closed or (pressed and event.key.code == sf::Keyboard::Escape)) {
+      running = false;
     }
-  }
-}
-
-void Game::render() {
-  window.clear(sf::Color::White);
-  for (std::list<Wall*> walls : all_walls) {
-    for (Wall * wall : walls) {
-      wall->render();
+    else if (pressed and event.key.code == sf::Keyboard::F3) {
+      show_profiler = !show_profiler;
     }
-  }
-  player->render();
-  gui->render();
-  window.display();
-}
-
-void Game::clear() {
-  delete player;
-  for (std::list<Wall*> & walls : all_walls) {
-    for (Wall * wall : walls) {
-        delete wall;
-        wall = NULL;
+    else if (pressed or event.type == sf::Event::KeyReleased or event.type == sf::Event::LostFocus) {
+      // Keys released while the window is not focused send no event
+      int first = 0, end = Input::K_SIZE;
+      if (event.type != sf::Event::LostFocus) {
+        first = Input::get_key(event.key.code);
+        end = first + 1;
+      }
+      int64_t now = Profiler::now();
+      for (int key = first; key < end and key < Input::K_SIZE; ++key) {
+        // When full, the oldest event is applied right away
+        if (key_events_end - key_events_begin == unsigned(max_key_events)) {
+          take_keys(key_events[key_events_begin % max_key_events].time);
+        }
+        KeyEvent & key_event = key_events[key_events_end++ % max_key_events];
+        key_event.time = now;
+        key_event.key = key;
+        key_event.pressed = pressed;
+      }
     }
   }
 }
 
-void Game::generate_game_walls(float delta_time) {
-  walls_next_target_timer -= delta_time;
-  // Timeout to change target
-  if (walls_next_target_timer < 0) {
-    // Increase difficulty
-    walls_next_target_timer = walls_next_target_timeout;
-    walls_next_target_timeout = std::max(min_walls_next_target_timeout, walls_next_target_timeout*0.95f);
-    one_way_probability = std::min(100, one_way_probability+2);
-
-    // Update target and check if now there is only one path
-    bool one_path = false;
-    for (int type = 0; type < num_types; ++type) {
-      walls_last_target[type] = walls_target[type];
-      walls_target[type] = walls_next_target[type];
-      walls_next_target[type] = rand()%num_positions;
-      if (walls_last_target[type] < 0 or walls_target[type] < 0) one_path = true;
-    }
-
-    // Join now to make next target only one path
-    bool join = (rand()%100 < one_way_probability);
-    if (!one_path and join) {
-      int pos = 0;
-      for (int type = 0; type < num_types; ++type) {
-        pos += abs(walls_last_target[type]);
-      }
-      pos /= num_types;
-      for (int type = 0; type < num_types; ++type) {
-        walls_target[type] = pos;
-      }
-      for (int type = 0; type < num_types; ++type) {
-        walls_next_target[type] = -(1 + (rand()%(num_positions-1)));  // Close path in random position
-      }
-      // Type that will survive, assign it a random position
-      int survive = rand()%num_types;
-      walls_next_target[survive] = rand()%num_positions;
+unsigned int Game::take_keys(int64_t time) {
+  unsigned int pressed = 0, taps = 0;
+  for (; key_events_begin != key_events_end; ++key_events_begin) {
+    const KeyEvent & key_event = key_events[key_events_begin % max_key_events];
+    if (key_event.time > time) break;
+    unsigned int bit = 1u << key_event.key;
+    if (key_event.pressed) {
+      pressed |= bit;
+      keys_down |= bit;
     }
-    
-    // Limit next target by walls_max_dist
-    for (int type = 0; type < num_types; ++type) {
-      // Check the distance even if there is a negative target
-      if (walls_next_target[type] >= 0) {
-        walls_next_target[type] = rand()%num_positions;
-        if (std::abs(std::abs(walls_target[type])-walls_next_target[type] > walls_max_dist)) {
-          if (std::abs(walls_target[type]) > walls_next_target[type]) {
-            walls_next_target[type] = std::abs(walls_target[type]) - walls_max_dist;
-          }
-          else {
-            walls_next_target[type] = std::abs(walls_target[type]) + walls_max_dist;
-          }
-        }
-      }
+    else {
+      // Pressed and released within the step
+      if (pressed & bit) taps |= bit;
+      keys_down &= ~bit;
     }
+    if (!event_time) event_time = key_event.time;
   }
-  
-  for (int type = 0; type < num_types; ++type) {
-    std::list<Wall*> & walls = all_walls[type];
-    if (walls.empty()) {
-      walls.push_back(new Wall(*this, type, speed,
-                               sf::Vector2f(SCREEN_WIDTH, 150.0f*(type+1)),
-                               sf::Vector2f(walls_width, 0.0f)));
-    }
-    float last_x = walls.back()->get_pos().x + walls_width;
-    float last_y = walls.back()->get_pos().y;
-    float last_height = walls.back()->get_size().y;
-
-    //time left
-    float time_left = walls_next_target_timer;
-    int target_ind = std::abs(walls_target[type]);  // Abs to send closed paths to its position
-
-    while (last_x < SCREEN_WIDTH) {
-      float factor = std::max(1.0f, 3.0f*(1-time_left));
-      float new_y = last_y + (target_positions[target_ind] - last_y)*delta_time*factor;
-      float new_height = last_height + (walls_min_height - last_height)*delta_time;
+  return keys_down | taps << Input::tap_shift;
+}
 
-      if (walls_target[type] < 0) new_height = last_height + (0.0f - last_height)*delta_time;
-      walls.push_back(new Wall(*this, type, speed,
-                               sf::Vector2f(last_x, new_y),
-                               sf::Vector2f(walls_width, new_height)));
-      last_height = new_height;
-      last_x = last_x + walls_width;
-      last_y = new_y;
-    }
+void Game::update_hud() {
+  int status = simulation.get_status();
+  // The score of the last playing step must reach the gui before game over
+  if (status == Simulation::PLAYING or last_status == Simulation::PLAYING) {
+    hud_score = simulation.get_score();
+  }
+  if (status == Simulation::READY) {
+    hud_timeout = simulation.get_time_to_start()+1;
   }
+  if (status == Simulation::GAME_OVER and last_status != Simulation::GAME_OVER) {
+    ScoreStore::Run run = { int32_t(simulation.get_last_score()), simulation.get_play_time(),
+                            simulation.get_seed(), int64_t(time(NULL)) };
+    scores.add(run);
+  }
+  last_status = status;
 }
 
-void Game::generate_ready_walls() {
-  for (int type = 0; type < num_types; ++type) {
-    std::list<Wall*> & walls = all_walls[type];
-    float diff = walls_width;
-    if (type > 0) diff *= -1;
-    if (walls.empty() and type > 0) {
-      continue;
-    }
-    if (walls.empty() and type == 0) {
-      walls.push_back(new Wall(*this, type, speed,
-                               sf::Vector2f(SCREEN_WIDTH, SCREEN_HEIGHT/2.0f),
-                               sf::Vector2f(walls_width, 5.0f)));
-    }
-    float last_x = walls.back()->get_pos().x + walls_width;
-    float last_y = walls.back()->get_pos().y;
-    float last_height = walls.back()->get_size().y;
-    while (last_x < SCREEN_WIDTH) {
-      float new_y = std::max(0.0f, std::min(SCREEN_HEIGHT - walls_width, last_y-diff/2.0f));
-      float new_height = last_height + diff;
-      new_height = std::max(0.0f, std::min(new_height, SCREEN_HEIGHT - new_y));
-      walls.push_back(new Wall(*this, type, speed,
-                               sf::Vector2f(last_x, new_y),
-                               sf::Vector2f(walls_width, new_height)));
-      last_height = new_height;
-      last_x = last_x + walls_width;
-      last_y = new_y;
+void Game::publish(float alpha) {
+  Snapshot & snapshot = snapshots.get_write();
+  // Same sized lanes are copied into the vectors already there
+  snapshot.lanes = simulation.get_lanes();
+  snapshot.entities = simulation.get_entities();
+  snapshot.scroll = simulation.get_scroll();
+  snapshot.last_scroll = simulation.get_scroll(0.0f);
+  const Player & player = simulation.get_player();
+  snapshot.player_pos = player.get_pos();
+  snapshot.player_last_pos = player.get_pos(0.0f);
+  snapshot.player_size = player.get_size();
+  snapshot.player_type = player.get_type();
+  snapshot.ghost_visible = false;
+  if (versus) {
+    // Both players start a round together, but one that lost scrolls slower
+    const Simulation & opponent = versus->get_opponent();
+    const Player & ghost = opponent.get_player();
+    int status = opponent.get_status();
+    snapshot.ghost_visible = (status == Simulation::READY or status == Simulation::PLAYING);
+    snapshot.ghost_pos = ghost.get_pos() + sf::Vector2f(opponent.get_scroll() - simulation.get_scroll(), 0.0f);
+    snapshot.ghost_last_pos = ghost.get_pos(0.0f) +
+                              sf::Vector2f(opponent.get_scroll(0.0f) - simulation.get_scroll(0.0f), 0.0f);
+    snapshot.ghost_type = ghost.get_type();
+  }
+  snapshot.status = last_status;
+  snapshot.score = hud_score;
+  snapshot.timeout = hud_timeout;
+  snapshot.show_profiler = show_profiler;
+  if (show_profiler) {
+    const Profiler & profiler = Profiler::instance();
+    for (int zone = 0; zone < Profiler::Z_SIZE; ++zone) {
+      snapshot.profiler_stats[zone] = profiler.get_stats(Profiler::Zone(zone));
+      snapshot.profiler_allocs[zone] = profiler.get_alloc_stats(Profiler::Zone(zone));
     }
   }
+  snapshot.alpha = alpha;
+  snapshot.time = Profiler::now();
+  if (input_time <= presented_input_time) input_time = 0;
+  snapshot.input_time = input_time;
+  snapshots.publish();
 }
 
-void Game::generate_menu_walls() {
-  float size = 100.0f;
-  float sin_diff = 30.0f;
-  float y_offset = 100.0f;
-  for (int type = 0; type < num_types; ++type) {
-    std::list<Wall*> & walls = all_walls[type];
-    float diff = sin_diff * sin(total_time * (1.337f * (type+1)));
-    float pos_y = y_offset*(type+1) + diff;
-    if (walls.empty()) {
-      walls.push_back(new Wall(*this, type, speed,
-                               sf::Vector2f(SCREEN_WIDTH, pos_y),
-                               sf::Vector2f(walls_width, 5.0f)));
-    }
-    float last_x = walls.back()->get_pos().x + walls_width;
-    float last_height = walls.back()->get_size().y;
-    while (last_x < SCREEN_WIDTH) {
-      float new_height = std::min(last_height + walls_width/2.0f, size);
-      walls.push_back(new Wall(*this, type, speed,
-                               sf::Vector2f(last_x, pos_y),
-                               sf::Vector2f(walls_width, new_height)));
-      last_height = new_height;
-      last_x = last_x + walls_width;
-    }
+void Game::render_loop() {
+  window.setActive(true);
+  while (running) {
+    pacer.begin_frame();
+    draw();
+    pacer.end_frame();
   }
+  window.setActive(false);
 }
 
-void Game::generate_walls() {
-  for (int type = 0; type < num_types; ++type) {
-    std::list<Wall*> & walls = all_walls[type];
-    if (!walls.empty()) {
-      float last_y = walls.back()->get_pos().y;
-      float last_height = walls.back()->get_size().y;
-      float last_x = walls.back()->get_pos().x + walls_width;
-      while (last_x < SCREEN_WIDTH) {
-        float new_y = last_y + (rand()%int(walls_width))*(rand()&1 ? -1:1);
-        float new_height = last_height + (rand()%int(walls_width))*(rand()&1 ? -1:1);
-        new_height = std::max(walls_min_height, std::min(SCREEN_HEIGHT - new_y, new_height));
-        // limit new height
-        new_height = std::min(new_height, last_height + walls_width/2.0f);
-        // limit new y
-        new_y = std::max(0.0f, std::min(SCREEN_HEIGHT - new_height, new_y));
-        walls.push_back(new Wall(*this, type, speed,
-                        sf::Vector2f(last_x, new_y),
-                        sf::Vector2f(walls_width, new_height)));
+void Game::draw() {
+  bool acquired = snapshots.acquire();
+  const Snapshot & snapshot = snapshots.get_read();
+  AllocGuard guard(snapshot.status == Simulation::PLAYING and drawn_status == Simulation::PLAYING);
+  if (acquired) update_gui(snapshot);
+  // Frames drawn between two snapshots keep moving up to the last step
+  float alpha = snapshot.alpha + (Profiler::now() - snapshot.time)*1e-9f/step_time;
+  gui.update();
+  render(snapshot, std::min(alpha, 1.0f));
+}
 
-        last_x += walls_width;
-        last_y = new_y;
-        last_height = new_height;
-      }
-    }
-    else {
-      walls.push_back(new Wall(*this, type, speed,
-                      sf::Vector2f(SCREEN_WIDTH, 0),
-                      sf::Vector2f(walls_width, 50)));
-    }
+void Game::update_gui(const Snapshot & snapshot) {
+  int status = snapshot.status;
+  if (status == Simulation::PLAYING or drawn_status == Simulation::PLAYING) {
+    gui.set_score(snapshot.score);
   }
+  if (status != drawn_status) {
+    gui.set_status(status);
+  }
+  else if (status == Simulation::READY) {
+    gui.set_timeout(snapshot.timeout);
+  }
+  gui.set_profiler_visible(snapshot.show_profiler);
+  if (snapshot.show_profiler) gui.set_profiler_stats(snapshot.profiler_stats, snapshot.profiler_allocs);
+  drawn_status = status;
 }
 
-void Game::erase_old_walls() {
-  for (int type = 0; type < num_types; ++type) {
-    std::list<Wall*> & walls = all_walls[type];
-    bool move_next = true;
-    while (!walls.empty() and move_next) { 
-      float last_x = walls.front()->get_pos().x + walls_width;
-      move_next = (last_x <= 0);
-      if (move_next) {
-        delete walls.front();
-        walls.pop_front();
-      }
-    }
+void Game::render(const Snapshot & snapshot, float alpha) {
+  window.clear(sf::Color::White);
+  const std::vector<Lane> & lanes = snapshot.lanes;
+  float render_scroll = snapshot.last_scroll + (snapshot.scroll - snapshot.last_scroll)*alpha;
+  for (unsigned int type = 0; type < lanes.size(); ++type) {
+    lane_renderers[type].sync(lanes[type]);
+    lane_renderers[type].render(window, render_scroll);
+  }
+  render_entities(snapshot.entities, render_scroll);
+  if (snapshot.ghost_visible) {
+    sf::Vector2f pos = snapshot.ghost_last_pos + (snapshot.ghost_pos - snapshot.ghost_last_pos)*alpha;
+    sf::Color color = Actor::colors[snapshot.ghost_type];
+    color.a = 100;
+    write_quad(&ghost_vertices[0], pos, snapshot.player_size, color);
+    window.draw(ghost_vertices);
+  }
+  sf::Vector2f pos = snapshot.player_last_pos + (snapshot.player_pos - snapshot.player_last_pos)*alpha;
+  write_quad(&player_vertices[0], pos, snapshot.player_size, Actor::colors[snapshot.player_type]);
+  window.draw(player_vertices);
+  gui.render(window);
+  window.display();
+  if (start_time) {
+    std::cout << "Startup: initialized in " << (init_time - start_time)*1e-6 << " ms, first frame displayed after "
+              << (Profiler::now() - start_time)*1e-6 << " ms" << std::endl;
+    start_time = 0;
+  }
+  if (snapshot.input_time > presented_input_time) {
+    presented_input_time = snapshot.input_time;
+    pacer.add_latency(snapshot.input_time, Profiler::now());
   }
 }
 
-bool Game::player_inside() {
-  sf::Vector2f pos = player->get_pos(), size = player->get_size();
-  std::vector<sf::Vector2f> points { pos,
-                                     pos+size,
-                                     sf::Vector2f(pos.x+size.x, pos.y),
-                                     sf::Vector2f(pos.x, pos.y+size.y) };
-  int inside_points = 0;  // Bitmask indicating wich points are inside a wall of same type
-  
-  std::list<Wall*> & walls = all_walls[player->get_type()];
-  std::list<Wall*>::iterator wall_it = walls.begin();
-  while (wall_it != walls.end() and (*wall_it)->get_pos().x <= points[1].x) {
-    for (int i = 0; i < 4; ++i) {
-      if (!(inside_points&(1<<i))) {
-        if ((*wall_it)->contains_point(points[i])) {
-          inside_points |= (1<<i);
-        }
-      }
+void Game::write_quad(sf::Vertex * quad, const sf::Vector2f & pos, const sf::Vector2f & size,
+                      const sf::Color & color) {
+  quad[0] = sf::Vertex(pos, color);
+  quad[1] = sf::Vertex(sf::Vector2f(pos.x + size.x, pos.y), color);
+  quad[2] = sf::Vertex(pos + size, color);
+  quad[3] = sf::Vertex(sf::Vector2f(pos.x, pos.y + size.y), color);
+}
+
+void Game::render_entities(const Entities & entities, float scroll) {
+  // The vertex array keeps its storage, so this only allocates when it grows
+  entity_vertices.resize(4*entities.size());
+  unsigned int v = 0;
+  for (int kind = 0; kind < Entities::K_SIZE; ++kind) {
+    const Entities::Group & group = entities.get_group(Entities::Kind(kind));
+    for (int i = 0; i < group.count; ++i) {
+      sf::Color color = Entities::get_color(Entities::Kind(kind), group.type[i]);
+      float left = group.x[i], right = left + group.width[i];
+      float top = group.y[i], bottom = top + group.height[i];
+      sf::Vertex * quad = &entity_vertices[v];
+      quad[0] = sf::Vertex(sf::Vector2f(left, top), color);
+      quad[1] = sf::Vertex(sf::Vector2f(right, top), color);
+      quad[2] = sf::Vertex(sf::Vector2f(right, bottom), color);
+      quad[3] = sf::Vertex(sf::Vector2f(left, bottom), color);
+      v += 4;
     }
-    ++wall_it;
   }
-  return inside_points == (1<<4)-1;  // All points visited;
+  sf::RenderStates states;
+  states.transform.translate(-scroll, 0.0f);
+  window.draw(entity_vertices, states);
 }
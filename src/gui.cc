@@ -1,35 +1,33 @@
 #include "gui.h"
 #include "utils.h"
-#include "game.h"
+#include "simulation.h"
+#include "profiler.h"
+#include "assets.h"
 
-Gui::Gui(Game & game) : game(game) {
-  text.resize(Game::S_SIZE);
-  text[Game::MENU].setString("Keep your color" 
+Gui::Gui() {
+  text.resize(Simulation::S_SIZE);
+  text[Simulation::MENU].setString("Keep your color" 
                              "\n\nStay in the zone that shares your color."
                              "\nYou can change your color in a mixed color zone."
                              "\nTo your change color, press SPACE."
                              "\nTo move, use the arrow keys UP and DOWN."
                              "\nPress SPACE to start, ESCAPE to exit");
-  text[Game::READY].setString("Get ready...");
-  text[Game::PLAYING].setString("Score: 0");
-  text[Game::GAME_OVER].setString("Game Over.\nPress SPACE to start again");
+  text[Simulation::GAME_OVER].setString("Game Over.\nPress SPACE to start again");
 }
 
 Gui::~Gui() {}
 
 bool Gui::init() {
-  status = Game::MENU;
+  status = Simulation::MENU;
   index = 0;
   score = 0;
-  std::ifstream file("best_score.txt");
   best_score = 0;
-  if (file.is_open()) {
-    file >> best_score;
-  }
-  file.close();
   timeout = 0;
-  if (!font.loadFromFile("fonts/Audiowide-Regular.ttf")) {
-    std::cerr << "Error loading font fonts/NovaMono.ttf" << std::endl;
+  seed = 0;
+  // The font is built into the executable, see Assets
+  const Assets::Asset * font_asset = Assets::find("fonts/Audiowide-Regular.ttf");
+  if (!font_asset or !font.loadFromMemory(font_asset->data, font_asset->size)) {
+    std::cerr << "Error loading font fonts/Audiowide-Regular.ttf" << std::endl;
     return false;
   }
   for (sf::Text & t : text) {
@@ -37,41 +35,69 @@ bool Gui::init() {
     t.setColor(sf::Color::Black);
     t.setCharacterSize(24);
   }
+  score_text.init(font, 24, sf::Color::Black, "Score: ");
+  score_text.set_number(score);
+  timeout_text.init(font, 24, sf::Color::Black, "Game starts in: ");
+  timeout_text.set_number(timeout);
+  show_profiler = false;
+  profiler_frames = 0;
+  for (int zone = 0; zone < Profiler::Z_SIZE; ++zone) {
+    profiler_stats[zone] = Profiler::Stats();
+    profiler_allocs[zone] = Profiler::AllocStats();
+  }
+  profiler_text.setFont(font);
+  profiler_text.setColor(sf::Color(60, 60, 60));
+  profiler_text.setCharacterSize(12);
+  profiler_text.setPosition(SCREEN_WIDTH - 420.0f, 4.0f);
   return true;
 }
 
-void Gui::render() {
-  game.get_window().draw(text[status]);
-  std::string s = text[status].getString();
+void Gui::render(sf::RenderTarget & target) {
+  if (status == Simulation::PLAYING) score_text.render(target);
+  else if (status == Simulation::READY) timeout_text.render(target);
+  else target.draw(text[status]);
+  if (show_profiler) target.draw(profiler_text);
 }
 
 void Gui::update() {
+  // Refresh the overlay a few times per second, it is not worth more
+  if (!show_profiler or profiler_frames++ % 30 != 0) return;
+  // The overlay allocates its text, it is exempt from allocation checks
+  AllocGuard guard(false);
+  std::stringstream ss;
+  ss.setf(std::ios::fixed);
+  ss.precision(2);
+  ss << "zone  p50 / p99 / max ms  allocs (bytes) / max";
+  for (int zone = 0; zone < Profiler::Z_SIZE; ++zone) {
+    const Profiler::Stats & stats = profiler_stats[zone];
+    const Profiler::AllocStats & allocs = profiler_allocs[zone];
+    ss << "\n" << Profiler::get_name(Profiler::Zone(zone)) << "  "
+       << stats.p50 << " / " << stats.p99 << " / " << stats.max << "  "
+       << allocs.allocations << " (" << allocs.bytes << ") / " << allocs.max_allocations;
+  }
+  profiler_text.setString(ss.str());
 }
 
 void Gui::set_score(int score) {
   if (this->score != score) {
     this->score = score;
-    std::stringstream ss;
-    ss << "Score: " << score;
-    text[Game::PLAYING].setString(ss.str()); 
+    score_text.set_number(score);
   }
 }
 
 void Gui::set_timeout(int timeout) {
   if (timeout != this->timeout) {
     this->timeout = timeout;
-    std::stringstream ss;
-    ss << "Game starts in: " << timeout;
-    text[Game::READY].setString(ss.str());
+    timeout_text.set_number(timeout);
   }
 }
 
 void Gui::set_status(int status) {
   index = 0;
   this->status = status;
-  if (status == Game::PLAYING) set_score(0);
-  if (status == Game::READY) set_timeout(3);
-  if (status == Game::GAME_OVER) {
+  if (status == Simulation::PLAYING) set_score(0);
+  if (status == Simulation::READY) set_timeout(3);
+  if (status == Simulation::GAME_OVER) {
     bool new_best_score = (score > best_score);
     best_score = std::max(score, best_score);
     std::stringstream ss;
@@ -83,15 +109,27 @@ void Gui::set_status(int status) {
       ss << "\nScore: " << score;
     }
     ss << "\nBest score: " << best_score << 
+          "\nSeed: " << seed <<
           "\nPress Space to start again";
-    text[Game::GAME_OVER].setString(ss.str());
+    text[Simulation::GAME_OVER].setString(ss.str());
   }
 }
 
-void Gui::save_score() {
-  std::ofstream file("best_score.txt");
-  if (file.is_open()) {
-    file << best_score;
-  }
-  file.close();
+void Gui::set_seed(uint64_t seed) {
+  this->seed = seed;
+}
+
+void Gui::set_profiler_visible(bool visible) {
+  if (visible == show_profiler) return;
+  show_profiler = visible;
+  profiler_frames = 0;
+}
+
+void Gui::set_profiler_stats(const Profiler::Stats * stats, const Profiler::AllocStats * allocs) {
+  std::copy(stats, stats + Profiler::Z_SIZE, profiler_stats);
+  std::copy(allocs, allocs + Profiler::Z_SIZE, profiler_allocs);
+}
+
+void Gui::set_best_score(int best_score) {
+  this->best_score = best_score;
 }
@@ -0,0 +1,96 @@
+#include "hud_text.h"
+#include <cstring>
+
+namespace {
+
+// Characters rasterized up front, any label must be made of these
+const char charset[] = " 0123456789-:.abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+}  // namespace
+
+const int HudText::max_chars;
+
+HudText::HudText()
+  : font(NULL), size(0), glyphs(), vertices(sf::Quads, 4*max_chars), label_length(0), length(0) {
+  pen[0] = 0.0f;
+}
+
+HudText::~HudText() {}
+
+void HudText::init(const sf::Font & font, unsigned int size, const sf::Color & color, const char * label) {
+  this->font = &font;
+  this->size = size;
+  for (const char * c = charset; *c; ++c) {
+    const sf::Glyph & glyph = font.getGlyph(*c, size, false);
+    Glyph & cached = glyphs[int(*c)];
+    cached.bounds = glyph.bounds;
+    cached.texture = sf::FloatRect(glyph.textureRect.left, glyph.textureRect.top,
+                                   glyph.textureRect.width, glyph.textureRect.height);
+    cached.advance = glyph.advance;
+  }
+  for (unsigned int i = 0; i < vertices.getVertexCount(); ++i) {
+    vertices[i].color = color;
+    vertices[i].position = sf::Vector2f(0.0f, 0.0f);
+  }
+  label_length = std::min(int(strlen(label)), max_chars - 12);
+  memcpy(chars, label, label_length);
+  length = label_length;
+  write_chars(0);
+}
+
+void HudText::set_number(int number) {
+  // Digits come out last first, so fill a buffer from its end
+  char digits[12];
+  int count = 0;
+  unsigned int value = number < 0 ? -unsigned(number) : number;
+  do {
+    digits[sizeof(digits) - 1 - count++] = '0' + value%10;
+    value /= 10;
+  } while (value > 0);
+  if (number < 0) digits[sizeof(digits) - 1 - count++] = '-';
+  const char * first = digits + sizeof(digits) - count;
+
+  int new_length = label_length + count;
+  int changed = label_length;
+  while (changed < std::min(length, new_length) and chars[changed] == first[changed - label_length]) {
+    ++changed;
+  }
+  if (changed == length and length == new_length) return;
+  memcpy(chars + label_length, first, count);
+  // Collapse the quads of characters that are gone
+  for (int i = new_length; i < length; ++i) {
+    for (int v = 0; v < 4; ++v) vertices[4*i + v].position = sf::Vector2f(0.0f, 0.0f);
+  }
+  length = new_length;
+  write_chars(changed);
+}
+
+void HudText::render(sf::RenderTarget & target) const {
+  if (!font) return;
+  target.draw(vertices, sf::RenderStates(&font->getTexture(size)));
+}
+
+void HudText::write_chars(int index) {
+  // Glyph bounds are relative to the baseline, one character size down
+  float baseline = size;
+  for (int i = index; i < length; ++i) {
+    // Characters out of charset have empty glyphs and take no room
+    const Glyph & glyph = glyphs[chars[i] & 0x7f];
+    float left = pen[i] + glyph.bounds.left;
+    float top = baseline + glyph.bounds.top;
+    float right = left + glyph.bounds.width;
+    float bottom = top + glyph.bounds.height;
+    float u = glyph.texture.left, v = glyph.texture.top;
+    float u2 = u + glyph.texture.width, v2 = v + glyph.texture.height;
+    sf::Vertex * quad = &vertices[4*i];
+    quad[0].position = sf::Vector2f(left, top);
+    quad[1].position = sf::Vector2f(right, top);
+    quad[2].position = sf::Vector2f(right, bottom);
+    quad[3].position = sf::Vector2f(left, bottom);
+    quad[0].texCoords = sf::Vector2f(u, v);
+    quad[1].texCoords = sf::Vector2f(u2, v);
+    quad[2].texCoords = sf::Vector2f(u2, v2);
+    quad[3].texCoords = sf::Vector2f(u, v2);
+    pen[i+1] = pen[i] + glyph.advance;
+  }
+}
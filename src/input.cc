@@ -1,31 +1,44 @@
 #include "input.h"
 
-Input::Input() {
-  key_mapping[PLAYER_UP] = sf::Keyboard::Up;
-  key_mapping[PLAYER_DOWN] = sf::Keyboard::Down;
-  key_mapping[PLAYER_ACTION] = sf::Keyboard::Space;
-  key_mapping[EXIT] = sf::Keyboard::Escape;
-}
+const sf::Keyboard::Key Input::key_mapping[K_SIZE] = {
+  sf::Keyboard::Up,     // PLAYER_UP
+  sf::Keyboard::Down,   // PLAYER_DOWN
+  sf::Keyboard::Left,   // PLAYER_LEFT
+  sf::Keyboard::Right,  // PLAYER_RIGHT
+  sf::Keyboard::Space,  // PLAYER_ACTION
+  sf::Keyboard::Escape  // EXIT
+};
+
+Input::Input() : key_status(0), old_key_status(0) {}
 
 Input::~Input() {}
 
-void Input::update() {
-  for (int k = 0; k < K_SIZE; ++k) {
-    old_key_status[k] = key_status[k];
-  }
+const int Input::tap_shift;
+
+Input::Key Input::get_key(sf::Keyboard::Key code) {
   for (int k = 0; k < K_SIZE; ++k) {
-    key_status[k] = sf::Keyboard::isKeyPressed(key_mapping[k]);
+    if (key_mapping[k] == code) return Key(k);
   }
+  return K_SIZE;
+}
+
+void Input::update(unsigned int keys) {
+  old_key_status = key_status;
+  key_status = keys;
+}
+
+unsigned int Input::get_keys() const {
+  return key_status;
 }
 
 bool Input::key_down(int key) const {
-  return key_status[key];
+  return (key_status | key_status >> tap_shift) & (1u<<key);
 }
 
 bool Input::key_pressed(int key) const {
-  return key_status[key] and !old_key_status[key];
+  return ((key_status & ~old_key_status) | key_status >> tap_shift) & (1u<<key);
 }
 
 bool Input::key_released(int key) const {
-  return !key_status[key] and old_key_status[key];
+  return ((~key_status & old_key_status) | key_status >> tap_shift) & (1u<<key);
 }
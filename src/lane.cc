@@ -0,0 +1,239 @@
+#include "lane.h"
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const int Lane::max_lanes;
+
+Lane::Lane(int type, float width, int capacity)
+  : type(type), width(width), inv_width(1.0f/width), first(0), end(0), epoch(0) {
+  // Round the capacity up to a power of two so slots wrap with a mask
+  int size = 1;
+  while (size < capacity) size <<= 1;
+  mask = size - 1;
+  x.resize(size);
+  y.resize(size);
+  height.resize(size);
+}
+
+Lane::~Lane() {}
+
+int Lane::get_type() const {
+  return type;
+}
+
+float Lane::get_width() const {
+  return width;
+}
+
+int Lane::size() const {
+  return end - first;
+}
+
+int Lane::capacity() const {
+  return mask + 1;
+}
+
+bool Lane::empty() const {
+  return end == first;
+}
+
+void Lane::push_back(float x, float y, float height) {
+  if (size() == capacity()) pop_front();
+  int s = end & mask;
+  this->x[s] = x;
+  this->y[s] = y;
+  this->height[s] = height;
+  ++end;
+}
+
+void Lane::pop_front() {
+  if (empty()) return;
+  ++first;
+}
+
+int Lane::get_back_segment(int count, float *& x, float *& y, float *& height) {
+  int s = end & mask;
+  // Only as many front columns go as the slots handed out need
+  int n = std::min(count, capacity() - s);
+  int room = capacity() - size();
+  if (n > room) first += n - room;
+  x = &this->x[s];
+  y = &this->y[s];
+  height = &this->height[s];
+  return n;
+}
+
+void Lane::commit_back(int count) {
+  end += count;
+}
+
+void Lane::clear() {
+  first = end;
+}
+
+unsigned int Lane::get_first() const {
+  return first;
+}
+
+unsigned int Lane::get_end() const {
+  return end;
+}
+
+float Lane::get_x(int i) const {
+  return x[slot(i)];
+}
+
+float Lane::get_y(int i) const {
+  return y[slot(i)];
+}
+
+float Lane::get_height(int i) const {
+  return height[slot(i)];
+}
+
+bool Lane::contains_point(int i, const sf::Vector2f & p) const {
+  int s = slot(i);
+  return (p.x >= x[s] and p.x <= x[s]+width and
+          p.y >= y[s] and p.y <= y[s]+height[s]);
+}
+
+int Lane::get_index(float x) const {
+  if (empty()) return -1;
+  float offset = (x - get_x(0))*inv_width;
+  if (offset < 0.0f or offset >= size()) return -1;
+  return int(offset);
+}
+
+int Lane::get_nearest(float x) const {
+  if (empty()) return -1;
+  // Clamp instead of using get_index, points on the outer edges count too
+  int i = int((x - get_x(0))*inv_width);
+  return std::max(0, std::min(size()-1, i));
+}
+
+bool Lane::contains_point(const sf::Vector2f & p) const {
+  if (empty()) return false;
+  int i = get_nearest(p.x);
+  // Neighbours cover shared edges and rounding in the column positions
+  int from = std::max(0, i-1);
+  int to = std::min(size()-1, i+1);
+  for (int col = from; col <= to; ++col) {
+    if (contains_point(col, p)) return true;
+  }
+  return false;
+}
+
+bool Lane::contains_swept(const sf::Vector2f & from, const sf::Vector2f & to,
+                          const sf::Vector2f & size) const {
+  if (empty()) return false;
+  float dx = to.x - from.x;
+  float dy = to.y - from.y;
+  if (dx <= 0.0f) return true;
+  const float side_x[2] = { 0.0f, size.x };
+  for (int side = 0; side < 2; ++side) {
+    float x0 = from.x + side_x[side];
+    // Each column the side crosses holds it for a span of the move, and
+    // y is linear in it, so the ends of the span are enough
+    int last = get_nearest(x0 + dx);
+    for (int col = get_nearest(x0); col <= last; ++col) {
+      float t0 = std::max(0.0f, (get_x(col) - x0)/dx);
+      float t1 = std::min(1.0f, (get_x(col) + width - x0)/dx);
+      if (t1 <= t0) continue;
+      float ya = from.y + dy*t0;
+      float yb = from.y + dy*t1;
+      if (std::min(ya, yb) < get_y(col) or
+          std::max(ya, yb) + size.y > get_y(col) + get_height(col)) return false;
+    }
+  }
+  return true;
+}
+
+unsigned int Lane::get_coverage(const std::vector<Lane> & lanes, const sf::Vector2f & pos,
+                                const sf::Vector2f & size) {
+  // The three columns around each side of the rectangle, gathered with
+  // lanes along the rows. Missing columns get a NaN x, which fails every test.
+  const int num_columns = 6;
+  alignas(16) float left[num_columns][max_lanes];
+  alignas(16) float right[num_columns][max_lanes];
+  alignas(16) float top[num_columns][max_lanes];
+  alignas(16) float bottom[num_columns][max_lanes];
+  const float side_x[2] = { pos.x, pos.x + size.x };
+  const float top_y = pos.y, bottom_y = pos.y + size.y;
+  int count = std::min(int(lanes.size()), max_lanes);
+  int padded = (count + 3) & ~3;
+  for (int type = 0; type < padded; ++type) {
+    for (int side = 0; side < 2; ++side) {
+      int i = type < count ? lanes[type].get_nearest(side_x[side]) : -1;
+      for (int d = 0; d < 3; ++d) {
+        int c = 3*side + d;
+        if (i < 0) {
+          left[c][type] = right[c][type] = std::numeric_limits<float>::quiet_NaN();
+          top[c][type] = bottom[c][type] = 0.0f;
+          continue;
+        }
+        const Lane & lane = lanes[type];
+        int col = std::max(0, std::min(lane.size()-1, i+d-1));
+        left[c][type] = lane.get_x(col);
+        right[c][type] = lane.get_x(col) + lane.width;
+        top[c][type] = lane.get_y(col);
+        bottom[c][type] = lane.get_y(col) + lane.get_height(col);
+      }
+    }
+  }
+
+  unsigned int mask = 0;
+#ifdef __SSE2__
+  const __m128 py_top = _mm_set1_ps(top_y), py_bottom = _mm_set1_ps(bottom_y);
+  for (int type = 0; type < padded; type += 4) {
+    __m128 covered = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int side = 0; side < 2; ++side) {
+      const __m128 px = _mm_set1_ps(side_x[side]);
+      __m128 top_in = _mm_setzero_ps(), bottom_in = _mm_setzero_ps();
+      for (int c = 3*side; c < 3*side + 3; ++c) {
+        __m128 l = _mm_load_ps(&left[c][type]), r = _mm_load_ps(&right[c][type]);
+        __m128 t = _mm_load_ps(&top[c][type]), b = _mm_load_ps(&bottom[c][type]);
+        __m128 in_x = _mm_and_ps(_mm_cmple_ps(l, px), _mm_cmple_ps(px, r));
+        top_in = _mm_or_ps(top_in, _mm_and_ps(in_x, _mm_and_ps(_mm_cmple_ps(t, py_top),
+                                                                _mm_cmple_ps(py_top, b))));
+        bottom_in = _mm_or_ps(bottom_in, _mm_and_ps(in_x, _mm_and_ps(_mm_cmple_ps(t, py_bottom),
+                                                                      _mm_cmple_ps(py_bottom, b))));
+      }
+      covered = _mm_and_ps(covered, _mm_and_ps(top_in, bottom_in));
+    }
+    mask |= unsigned(_mm_movemask_ps(covered)) << type;
+  }
+#else
+  for (int type = 0; type < count; ++type) {
+    bool covered = true;
+    for (int side = 0; side < 2; ++side) {
+      bool top_in = false, bottom_in = false;
+      for (int c = 3*side; c < 3*side + 3; ++c) {
+        bool in_x = left[c][type] <= side_x[side] and side_x[side] <= right[c][type];
+        top_in |= in_x and top[c][type] <= top_y and top_y <= bottom[c][type];
+        bottom_in |= in_x and top[c][type] <= bottom_y and bottom_y <= bottom[c][type];
+      }
+      covered &= top_in and bottom_in;
+    }
+    if (covered) mask |= 1u << type;
+  }
+#endif
+  return mask & ((1u << count) - 1);
+}
+
+void Lane::shift(float dx) {
+  int count = size();
+  for (int i = 0; i < count; ++i) {
+    x[slot(i)] += dx;
+  }
+  ++epoch;
+}
+
+unsigned int Lane::get_epoch() const {
+  return epoch;
+}
+
+int Lane::slot(int i) const {
+  return (first + i) & mask;
+}
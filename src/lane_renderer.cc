@@ -0,0 +1,52 @@
+#include "lane_renderer.h"
+#include "actor.h"
+
+LaneRenderer::LaneRenderer(const Lane & lane)
+  : vertices(sf::Quads, 4*lane.capacity()), color(Actor::colors[lane.get_type()]),
+    mask(lane.capacity()-1), first(lane.get_first()), end(lane.get_first()), epoch(lane.get_epoch()) {
+  color.a = 80;
+  for (unsigned int i = 0; i < vertices.getVertexCount(); ++i) {
+    vertices[i].color = color;
+  }
+}
+
+LaneRenderer::~LaneRenderer() {}
+
+void LaneRenderer::sync(const Lane & lane) {
+  unsigned int lane_first = lane.get_first();
+  unsigned int lane_end = lane.get_end();
+  // Collapse the quads of the columns popped since the last sync
+  unsigned int popped_end = end;
+  if (int(lane_first - end) < 0) popped_end = lane_first;
+  for (unsigned int seq = first; seq != popped_end; ++seq) {
+    write_quad(seq, sf::Vector2f(0.0f, 0.0f), sf::Vector2f(0.0f, 0.0f));
+  }
+
+  // Write the columns pushed since the last sync, or all of them if the
+  // lane's columns moved
+  unsigned int pushed_first = end;
+  if (int(lane_first - end) > 0 or lane.get_epoch() != epoch) pushed_first = lane_first;
+  for (unsigned int seq = pushed_first; seq != lane_end; ++seq) {
+    int i = seq - lane_first;
+    write_quad(seq, sf::Vector2f(lane.get_x(i), lane.get_y(i)),
+               sf::Vector2f(lane.get_width(), lane.get_height(i)));
+  }
+
+  first = lane_first;
+  end = lane_end;
+  epoch = lane.get_epoch();
+}
+
+void LaneRenderer::render(sf::RenderTarget & target, float scroll) const {
+  sf::RenderStates states;
+  states.transform.translate(-scroll, 0.0f);
+  target.draw(vertices, states);
+}
+
+void LaneRenderer::write_quad(unsigned int seq, const sf::Vector2f & pos, const sf::Vector2f & size) {
+  sf::Vertex * quad = &vertices[4*(seq & mask)];
+  quad[0].position = pos;
+  quad[1].position = sf::Vector2f(pos.x + size.x, pos.y);
+  quad[2].position = pos + size;
+  quad[3].position = sf::Vector2f(pos.x, pos.y + size.y);
+}
@@ -0,0 +1,284 @@
+#include "lockstep.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+const int Lockstep::max_input_delay;
+const int Lockstep::max_packet_keys;
+const int Lockstep::num_samples;
+const int Lockstep::ring_size;
+const int64_t Lockstep::resend_interval = 10000000;
+
+namespace {
+
+void write_bytes(uint8_t * data, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    data[i] = uint8_t((value >> (8*i)) & 0xff);
+  }
+}
+
+uint64_t read_bytes(const uint8_t * data, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value |= uint64_t(data[i]) << (8*i);
+  }
+  return value;
+}
+
+// Session, acknowledgement, first step and count before the keys, step
+// count and hash after them
+const int header_size = 4 + 4 + 4 + 1;
+const int hash_size = 4 + 8;
+const int max_packet_size = header_size + 2*Lockstep::max_packet_keys + hash_size;
+
+// Blocks until fd can be read or timeout nanoseconds pass
+void wait_readable(int fd, int64_t timeout) {
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(fd, &fds);
+  timeval tv;
+  tv.tv_sec = timeout/1000000000;
+  tv.tv_usec = (timeout%1000000000)/1000;
+  select(fd + 1, &fds, NULL, NULL, &tv);
+}
+
+Profiler::Stats get_stats(const std::vector<int64_t> & samples, int count) {
+  Profiler::Stats stats = { 0.0f, 0.0f, 0.0f };
+  count = std::min(count, int(samples.size()));
+  if (count == 0) return stats;
+  std::vector<int64_t> times(samples.begin(), samples.begin() + count);
+  get_percentiles(&times[0], count, stats.p50, stats.p99, stats.max);
+  return stats;
+}
+
+}  // namespace
+
+Lockstep::Lockstep()
+  : socket_fd(-1), session(0), input_delay(0), step(0), local_end(0), ack(0), remote_end(0),
+    local_hash(0), pending_hash(0), pending_steps(0), desync_step(-1), last_send(0),
+    warned_session(false), round_trips(num_samples), round_trip_count(0), waits(num_samples),
+    wait_count(0) {
+  memset(&address, 0, sizeof(address));
+}
+
+Lockstep::~Lockstep() {
+  close();
+}
+
+bool Lockstep::open(int port, const std::string & host, int remote_port, uint32_t session, int input_delay) {
+  close();
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo * result = NULL;
+  if (getaddrinfo(host.c_str(), NULL, &hints, &result) != 0 or !result) {
+    std::cerr << "Unknown host " << host << std::endl;
+    return false;
+  }
+  memcpy(&address, result->ai_addr, sizeof(address));
+  freeaddrinfo(result);
+  address.sin_port = htons(remote_port);
+
+  sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons(port);
+  socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (socket_fd < 0 or bind(socket_fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0 or
+      fcntl(socket_fd, F_SETFL, O_NONBLOCK) != 0) {
+    std::cerr << "Error listening on port " << port << ": " << strerror(errno) << std::endl;
+    close();
+    return false;
+  }
+
+  this->session = session;
+  this->input_delay = std::max(0, std::min(max_input_delay, input_delay));
+  // The steps before the delay runs out have no keys on either side
+  step = 0;
+  for (int i = 0; i < ring_size; ++i) {
+    local_keys[i] = remote_keys[i] = 0;
+    send_times[i] = 0;
+  }
+  local_end = remote_end = ack = this->input_delay;
+  local_hash = 0;
+  pending_steps = 0;
+  desync_step = -1;
+  last_send = 0;
+  warned_session = false;
+  round_trip_count = wait_count = 0;
+  return true;
+}
+
+void Lockstep::close() {
+  if (socket_fd >= 0) ::close(socket_fd);
+  socket_fd = -1;
+}
+
+bool Lockstep::is_open() const {
+  return socket_fd >= 0;
+}
+
+int Lockstep::get_input_delay() const {
+  return input_delay;
+}
+
+uint32_t Lockstep::get_step() const {
+  return step;
+}
+
+bool Lockstep::needs_keys() const {
+  return local_end == step + input_delay;
+}
+
+void Lockstep::send(unsigned int keys) {
+  if (needs_keys()) {
+    local_keys[local_end % ring_size] = keys;
+    send_times[local_end % ring_size] = Profiler::now();
+    ++local_end;
+  }
+  transmit();
+}
+
+void Lockstep::receive() {
+  if (socket_fd < 0) return;
+  uint8_t packet[max_packet_size];
+  while (true) {
+    ssize_t size = recv(socket_fd, packet, sizeof(packet), 0);
+    if (size < 0) break;
+    read_packet(packet, size);
+  }
+}
+
+bool Lockstep::wait(int64_t timeout) {
+  receive();
+  if (ready() or socket_fd < 0) return ready();
+  int64_t start = Profiler::now();
+  int64_t now = start;
+  while (!ready() and now - start < timeout) {
+    if (now - last_send >= resend_interval) transmit();
+    wait_readable(socket_fd, std::min(timeout - (now - start), resend_interval));
+    receive();
+    now = Profiler::now();
+  }
+  waits[wait_count++ % num_samples] = now - start;
+  return ready();
+}
+
+bool Lockstep::ready() const {
+  return int32_t(local_end - step) > 0 and int32_t(remote_end - step) > 0;
+}
+
+unsigned int Lockstep::get_local_keys() const {
+  return local_keys[step % ring_size];
+}
+
+unsigned int Lockstep::get_remote_keys() const {
+  return remote_keys[step % ring_size];
+}
+
+void Lockstep::end_step(uint64_t local_hash, uint64_t remote_hash) {
+  remote_hashes[step % ring_size] = remote_hash;
+  ++step;
+  this->local_hash = local_hash;
+  if (pending_steps and int32_t(step - pending_steps) >= 0) {
+    check_hash(pending_steps, pending_hash);
+    pending_steps = 0;
+  }
+}
+
+int64_t Lockstep::get_desync_step() const {
+  return desync_step;
+}
+
+void Lockstep::flush(int64_t timeout) {
+  if (socket_fd < 0) return;
+  int64_t start = Profiler::now();
+  while (int32_t(local_end - ack) > 0 and Profiler::now() - start < timeout) {
+    transmit();
+    wait_readable(socket_fd, resend_interval);
+    receive();
+  }
+}
+
+Profiler::Stats Lockstep::get_round_trip() const {
+  return get_stats(round_trips, round_trip_count);
+}
+
+Profiler::Stats Lockstep::get_wait() const {
+  return get_stats(waits, wait_count);
+}
+
+int Lockstep::get_wait_count() const {
+  return wait_count;
+}
+
+void Lockstep::transmit() {
+  if (socket_fd < 0) return;
+  uint8_t packet[max_packet_size];
+  int count = std::min(int(local_end - ack), max_packet_keys);
+  write_bytes(packet, session, 4);
+  write_bytes(packet + 4, remote_end, 4);
+  write_bytes(packet + 8, ack, 4);
+  packet[12] = uint8_t(count);
+  uint8_t * data = packet + header_size;
+  for (int i = 0; i < count; ++i) {
+    write_bytes(data + 2*i, local_keys[(ack + i) % ring_size], 2);
+  }
+  data += 2*count;
+  write_bytes(data, step, 4);
+  write_bytes(data + 4, local_hash, 8);
+  // A packet that cannot be sent is as good as lost, the next one repeats it
+  sendto(socket_fd, packet, header_size + 2*count + hash_size, 0,
+         reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+  last_send = Profiler::now();
+}
+
+void Lockstep::read_packet(const uint8_t * packet, int size) {
+  if (size < header_size + hash_size or uint32_t(read_bytes(packet, 4)) != session) {
+    if (!warned_session) {
+      std::cerr << "Versus: ignoring packets of a run with another seed, rate or lane count" << std::endl;
+      warned_session = true;
+    }
+    return;
+  }
+  // Packets can come out of order, acknowledgements only move forward
+  uint32_t remote_ack = read_bytes(packet + 4, 4);
+  if (int32_t(remote_ack - ack) > 0 and int32_t(remote_ack - local_end) <= 0) {
+    int64_t now = Profiler::now();
+    for (uint32_t s = ack; s != remote_ack; ++s) {
+      int64_t sent = send_times[s % ring_size];
+      if (sent) round_trips[round_trip_count++ % num_samples] = now - sent;
+    }
+    ack = remote_ack;
+  }
+  uint32_t first = read_bytes(packet + 8, 4);
+  int count = packet[12];
+  if (size != header_size + 2*count + hash_size) return;
+  const uint8_t * data = packet + header_size;
+  for (int i = 0; i < count; ++i) {
+    // Only the next missing step is taken, the ones after a gap come again
+    if (first + i != remote_end or int32_t(remote_end - step) >= ring_size) continue;
+    remote_keys[remote_end % ring_size] = read_bytes(data + 2*i, 2);
+    ++remote_end;
+  }
+  data += 2*count;
+  check_hash(read_bytes(data, 4), read_bytes(data + 4, 8));
+}
+
+void Lockstep::check_hash(uint32_t steps, uint64_t hash) {
+  // No hash before the first step, and nothing more to learn after a desync
+  if (steps == 0 or desync_step >= 0) return;
+  if (int32_t(steps - step) > 0) {
+    pending_steps = steps;
+    pending_hash = hash;
+    return;
+  }
+  if (step - steps >= uint32_t(ring_size)) return;
+  if (remote_hashes[(steps - 1) % ring_size] != hash) desync_step = steps - 1;
+}
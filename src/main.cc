@@ -1,12 +1,262 @@
 #include "game.h"
+#include "simulation.h"
+#include "replay.h"
+#include "profiler.h"
+#include "software_renderer.h"
+#include "alloc_tracker.h"
+#include "lockstep.h"
+#include "versus.h"
 #include "utils.h"
 #include <iostream>
+#include <cstring>
+#include <iomanip>
+#include <ctime>
+#include <cctype>
 
-int main() {
-  srand(time(NULL));
-  Game game(SCREEN_WIDTH, SCREEN_HEIGHT, "Keep your color", sf::Style::Default);
-  if (game.init()) {
+// Path of the snapshot of a frame, with the frame number before the extension
+std::string get_snapshot_path(const std::string & path, long frame) {
+  std::stringstream ss;
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos or path.find('/', dot) != std::string::npos) dot = path.size();
+  ss << path.substr(0, dot) << "-" << std::setw(6) << std::setfill('0') << frame << path.substr(dot);
+  return ss.str();
+}
+
+// One line per run, with its date in UTC like the day index
+void print_run(const ScoreStore::Run & run) {
+  char date[32];
+  time_t timestamp = run.timestamp;
+  strftime(date, sizeof(date), "%Y-%m-%d %H:%M", gmtime(&timestamp));
+  std::cout << std::setw(8) << run.score << " points " << std::setw(7) << std::fixed
+            << std::setprecision(1) << run.duration << " s  seed " << run.seed << "  " << date << " UTC"
+            << std::endl;
+}
+
+// Prints the best runs ever and today's runs, read through the indices of
+// the score database
+void print_scores(int count) {
+  ScoreStore scores;
+  if (!scores.open("scores")) return;
+  std::cout << "Best " << count << " runs:" << std::endl;
+  for (const ScoreStore::Run & run : scores.get_top(count)) {
+    print_run(run);
+  }
+  std::cout << "Today:" << std::endl;
+  for (const ScoreStore::Run & run : scores.get_day(time(NULL))) {
+    print_run(run);
+  }
+}
+
+// Steps the simulation without a window, as fast as possible. Keys come
+// from the replay if there is one, otherwise Space is tapped every two
+// seconds of game time so runs go through every status. With a snapshot
+// path, the last frame is drawn in software and saved there, as well as
+// every snapshot_every frames if that is positive. With a lockstep link
+// the steps race the other side, waiting for its keys.
+void run_headless(const Simulation::Settings & settings, long frames, int rate, uint64_t seed,
+                  Replay * replay, Recorder * recorder, const char * snapshot_path,
+                  long snapshot_every, Lockstep * lockstep) {
+  const float delta_time = 1.0f/rate;
+  // Longest wait for the other side before giving up
+  const int64_t versus_timeout = 10000000000LL;
+  Simulation simulation(settings);
+  simulation.init(seed);
+  Versus * versus = NULL;
+  if (lockstep) {
+    versus = new Versus(simulation, settings, *lockstep);
+    versus->init(seed);
+  }
+  SoftwareRenderer renderer;
+  sf::Clock clock;
+  long frame = 0;
+  for (; frames < 0 or frame < frames; ++frame) {
+    Profiler::instance().begin_frame();
+    unsigned int keys = (frame%(2*rate) == 0) ? (1u<<Input::PLAYER_ACTION) : 0;
+    if (replay and !replay->next(keys)) break;
+    if (recorder) recorder->record(keys);
+    if (versus and !versus->wait(keys, versus_timeout)) {
+      std::cerr << "Versus: no keys from the other side" << std::endl;
+      break;
+    }
+    {
+      ProfileZone zone(Profiler::UPDATE);
+      AllocGuard guard(simulation.get_status() == Simulation::PLAYING);
+      if (versus) versus->update(delta_time);
+      else simulation.update(delta_time, keys);
+    }
+    if (snapshot_path and snapshot_every > 0 and (frame+1)%snapshot_every == 0) {
+      ProfileZone zone(Profiler::RENDER);
+      renderer.render(simulation);
+      renderer.save(get_snapshot_path(snapshot_path, frame+1));
+    }
+  }
+  float elapsed = clock.getElapsedTime().asSeconds();
+  std::cout << frame << " frames in " << elapsed << " s ("
+            << frame/std::max(elapsed, EPSILON) << " frames/s), seed " << seed
+            << ", state " << std::hex << simulation.get_hash();
+  if (snapshot_path) {
+    renderer.render(simulation);
+    renderer.save(snapshot_path);
+    std::cout << ", image " << renderer.get_hash();
+  }
+  std::cout << std::dec << std::endl;
+  if (versus) versus->print(std::cout);
+  delete versus;
+}
+
+int main(int argc, char * argv[]) {
+  int64_t start_time = Profiler::now();
+  bool headless = false;
+  long frames = -1;
+  int rate = Game::default_rate;
+  uint64_t seed = time(NULL);
+  bool seed_given = false;
+  Simulation::Settings settings;
+  const char * record_path = NULL;
+  const char * replay_path = NULL;
+  const char * trace_path = NULL;
+  bool render_thread = false;
+  FramePacer::Mode pacing = FramePacer::VSYNC;
+  float fps = 60.0f;
+  const char * snapshot_path = NULL;
+  long snapshot_every = 0;
+  AllocTracker::Check alloc_check = AllocTracker::OFF;
+  const char * versus_address = NULL;
+  int port = -1;
+  int input_delay = -1;
+  int scores_count = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      headless = true;
+    }
+    else if (strcmp(argv[i], "--frames") == 0 and i+1 < argc) {
+      frames = atol(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--rate") == 0 and i+1 < argc) {
+      rate = std::max(1, atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--seed") == 0 and i+1 < argc) {
+      seed = strtoull(argv[++i], NULL, 10);
+      seed_given = true;
+    }
+    else if (strcmp(argv[i], "--lanes") == 0 and i+1 < argc) {
+      settings.num_types = std::max(2, std::min(Lane::max_lanes, atoi(argv[++i])));
+    }
+    else if (strcmp(argv[i], "--record") == 0 and i+1 < argc) {
+      record_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--replay") == 0 and i+1 < argc) {
+      replay_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--trace") == 0 and i+1 < argc) {
+      trace_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--pacing") == 0 and i+1 < argc and
+             FramePacer::get_mode(argv[i+1]) != FramePacer::M_SIZE) {
+      pacing = FramePacer::get_mode(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--fps") == 0 and i+1 < argc) {
+      fps = std::max(1.0f, float(atof(argv[++i])));
+    }
+    else if (strcmp(argv[i], "--snapshot") == 0 and i+1 < argc) {
+      snapshot_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--snapshot-every") == 0 and i+1 < argc) {
+      snapshot_every = atol(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--alloc-check") == 0 and i+1 < argc and
+             AllocTracker::get_check(argv[i+1]) != AllocTracker::C_SIZE) {
+      alloc_check = AllocTracker::get_check(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--render-thread") == 0) {
+      render_thread = true;
+    }
+    else if (strcmp(argv[i], "--generator-thread") == 0) {
+      settings.generator_thread = true;
+    }
+    else if (strcmp(argv[i], "--versus") == 0 and i+1 < argc and strchr(argv[i+1], ':')) {
+      versus_address = argv[++i];
+    }
+    else if (strcmp(argv[i], "--port") == 0 and i+1 < argc) {
+      port = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--input-delay") == 0 and i+1 < argc) {
+      input_delay = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--scores") == 0) {
+      scores_count = 10;
+      if (i+1 < argc and isdigit(argv[i+1][0])) scores_count = std::max(1, atoi(argv[++i]));
+    }
+    else {
+      std::cerr << "Usage: " << argv[0] << " [--rate HZ] [--seed N] [--lanes N] [--record FILE] [--replay FILE]"
+                << " [--trace FILE] [--alloc-check off|log|abort] [--render-thread]"
+                << " [--generator-thread]"
+                << " [--pacing vsync|low-latency|cap [--fps HZ]]"
+                << " [--versus HOST:PORT [--port N] [--input-delay STEPS]]"
+                << " [--headless [--frames N] [--snapshot FILE [--snapshot-every N]]]"
+                << " [--scores [N]]" << std::endl;
+      return 1;
+    }
+  }
+
+  if (scores_count > 0) {
+    print_scores(scores_count);
+    return 0;
+  }
+
+  AllocTracker::set_check(alloc_check);
+
+  // A replay brings its own rate, seed and lane count
+  Replay replay;
+  if (replay_path) {
+    if (!replay.open(replay_path)) return 1;
+    rate = replay.get_rate();
+    seed = replay.get_seed();
+    settings.num_types = replay.get_lanes();
+  }
+  Recorder recorder;
+  if (record_path and !recorder.open(record_path, rate, seed, settings.num_types)) return 1;
+
+  // Both sides of a race need the same seed, rate and lane count
+  Lockstep lockstep;
+  if (versus_address) {
+    if (replay_path or record_path) {
+      std::cerr << "Versus runs cannot be recorded or replayed" << std::endl;
+      return 1;
+    }
+    if (!seed_given) seed = 0;
+    std::string address = versus_address;
+    size_t colon = address.rfind(':');
+    int remote_port = atoi(address.c_str() + colon + 1);
+    if (port < 0) port = remote_port;
+    // About 8 ms by default, well within a display frame
+    if (input_delay < 0) input_delay = std::max(1, rate/120);
+    if (!lockstep.open(port, address.substr(0, colon), remote_port,
+                       Versus::get_session(seed, rate, settings), input_delay)) return 1;
+  }
+
+  if (headless) {
+    // Without a replay to end it, a headless run is one minute of game time
+    if (frames < 0 and !replay_path) frames = 60*rate;
+    // Profiling costs a clock read per zone, so headless runs only pay it when asked
+    Profiler::instance().set_enabled(trace_path != NULL);
+    run_headless(settings, frames, rate, seed, replay_path ? &replay : NULL, record_path ? &recorder : NULL,
+                 snapshot_path, snapshot_every, versus_address ? &lockstep : NULL);
+  }
+  else {
+    Game game(SCREEN_WIDTH, SCREEN_HEIGHT, "Keep your color", sf::Style::Default, settings);
+    game.set_rate(rate);
+    game.set_render_thread(render_thread);
+    game.set_pacing(pacing, fps);
+    game.set_start_time(start_time);
+    if (replay_path) game.set_replay(&replay);
+    if (record_path) game.set_recorder(&recorder);
+    if (versus_address) game.set_lockstep(&lockstep);
+    if (!game.init(seed)) return 1;
     game.run();
   }
+  // Lets the other side finish the steps this one ran
+  if (versus_address) lockstep.flush(1000000000);
+  if (trace_path) Profiler::instance().write_trace(trace_path);
   return 0;
 }
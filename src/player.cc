@@ -1,4 +1,4 @@
-#include "game.h"
+#include "simulation.h"
 #include "utils.h"
 #include "input.h"
 #include "player.h"
@@ -8,16 +8,17 @@ const float Player::acc = 700.0f;
 const float Player::dec = 3000.0f;
 const float Player::first_move_speed = 50.0f;
 
-Player::Player(Game & game, int type, float speed) : Actor(game, type, speed) {
+Player::Player(Simulation & simulation, int type, float speed) : Actor(simulation, type, speed) {
   act_speed = 0.0f;
   size = sf::Vector2f(20, 20);
   pos.x = 50;  pos.y = SCREEN_HEIGHT/2.0f - size.y/2.0f;
+  last_pos = pos;
 }
 
 Player::~Player() {}
 
 void Player::update(float delta_time) {
-  const Input & input = game.get_input();
+  const Input & input = simulation.get_input();
   if (input.key_down(input.Key::PLAYER_DOWN) ^ input.key_down(input.Key::PLAYER_UP)) {
     float acceleration = acc;
     if (input.key_down(input.Key::PLAYER_UP)) {
@@ -46,20 +47,12 @@ void Player::update(float delta_time) {
                     std::max(0.0f, pos.y + act_speed * delta_time));
 
   if (input.key_pressed(input.Key::PLAYER_ACTION)) {
-    type = 1-type;
+    // Cycle through the colors
+    type = (type+1) % simulation.get_lanes().size();
   }
 }
 
-void Player::render() {
-  sf::Color color = colors[type];
-  sf::RectangleShape rectangle(size);
-  
-  rectangle.setPosition(pos);
-  rectangle.setFillColor(color);
-  game.get_window().draw(rectangle);
-}
-
-const sf::Vector2f Player::get_size() {
+const sf::Vector2f Player::get_size() const {
   return size;
 }
 
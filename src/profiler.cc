@@ -0,0 +1,135 @@
+#include "profiler.h"
+#include <chrono>
+#include <iomanip>
+
+namespace {
+
+const char * zone_names[Profiler::Z_SIZE] = {
+  "frame", "events", "update", "render",
+  "menu_update", "ready_update", "playing_update", "game_over_update"
+};
+
+}  // namespace
+
+const int Profiler::num_frames;
+const int Profiler::num_events;
+
+Profiler & Profiler::instance() {
+  static Profiler profiler;
+  return profiler;
+}
+
+Profiler::Profiler() : enabled(false), epoch(now()), frame(0), event_end(0) {
+  for (int zone = 0; zone < Z_SIZE; ++zone) {
+    std::fill(frame_times[zone], frame_times[zone] + num_frames, 0);
+    for (AllocTracker::Counts & counts : frame_allocations[zone]) {
+      counts.allocations = counts.bytes = 0;
+    }
+  }
+}
+
+void Profiler::set_enabled(bool enabled) {
+  if (enabled and events.empty()) events.resize(num_events);
+  this->enabled = enabled;
+}
+
+bool Profiler::is_enabled() const {
+  return enabled;
+}
+
+void Profiler::begin_frame() {
+  unsigned int next = frame.load(std::memory_order_relaxed) + 1;
+  for (int zone = 0; zone < Z_SIZE; ++zone) {
+    frame_times[zone][next % num_frames] = 0;
+    frame_allocations[zone][next % num_frames].allocations = 0;
+    frame_allocations[zone][next % num_frames].bytes = 0;
+  }
+  frame.store(next, std::memory_order_release);
+}
+
+void Profiler::add(Zone zone, int64_t start, int64_t duration,
+                   const AllocTracker::Counts & allocations) {
+  unsigned int slot = frame.load(std::memory_order_relaxed) % num_frames;
+  frame_times[zone][slot] += duration;
+  frame_allocations[zone][slot].allocations += allocations.allocations;
+  frame_allocations[zone][slot].bytes += allocations.bytes;
+  unsigned int end = event_end.load(std::memory_order_relaxed);
+  Event & event = events[end % num_events];
+  event.zone = zone;
+  event.start = start;
+  event.duration = duration;
+  event_end.store(end + 1, std::memory_order_release);
+}
+
+int64_t Profiler::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char * Profiler::get_name(Zone zone) {
+  return zone_names[zone];
+}
+
+Profiler::Stats Profiler::get_stats(Zone zone) const {
+  Stats stats = { 0.0f, 0.0f, 0.0f };
+  unsigned int current = frame.load(std::memory_order_acquire);
+  int count = std::min(current, unsigned(num_frames - 1));
+  if (count == 0) return stats;
+  int64_t times[num_frames];
+  for (int i = 0; i < count; ++i) {
+    times[i] = frame_times[zone][(current - 1 - i) % num_frames];
+  }
+  get_percentiles(times, count, stats.p50, stats.p99, stats.max);
+  return stats;
+}
+
+Profiler::AllocStats Profiler::get_alloc_stats(Zone zone) const {
+  AllocStats stats = { 0, 0, 0 };
+  unsigned int current = frame.load(std::memory_order_acquire);
+  int count = std::min(current, unsigned(num_frames - 1));
+  if (count == 0) return stats;
+  const AllocTracker::Counts & last = frame_allocations[zone][(current - 1) % num_frames];
+  stats.allocations = last.allocations;
+  stats.bytes = last.bytes;
+  for (int i = 0; i < count; ++i) {
+    stats.max_allocations = std::max(stats.max_allocations,
+                                     frame_allocations[zone][(current - 1 - i) % num_frames].allocations);
+  }
+  return stats;
+}
+
+bool Profiler::write_trace(const std::string & path) const {
+  std::ofstream file(path.c_str());
+  if (!file.is_open()) {
+    std::cerr << "Error writing trace " << path << std::endl;
+    return false;
+  }
+  unsigned int end = event_end.load(std::memory_order_acquire);
+  unsigned int begin = end > unsigned(num_events) ? end - num_events : 0;
+  file << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+  for (unsigned int i = begin; i != end; ++i) {
+    const Event & event = events[i % num_events];
+    file << (i == begin ? "\n" : ",\n")
+         << "{\"name\": \"" << zone_names[event.zone] << "\", \"ph\": \"X\""
+         << ", \"ts\": " << (event.start - epoch) / 1e3
+         << ", \"dur\": " << event.duration / 1e3
+         << ", \"pid\": 1, \"tid\": 1}";
+  }
+  file << "\n]}\n";
+  return true;
+}
+
+ProfileZone::ProfileZone(Profiler::Zone zone)
+  : zone(zone), start(Profiler::instance().is_enabled() ? Profiler::now() : 0),
+    start_allocations(AllocTracker::get_thread_counts()) {
+}
+
+ProfileZone::~ProfileZone() {
+  Profiler & profiler = Profiler::instance();
+  if (profiler.is_enabled()) {
+    AllocTracker::Counts end_allocations = AllocTracker::get_thread_counts();
+    AllocTracker::Counts allocations = { end_allocations.allocations - start_allocations.allocations,
+                                         end_allocations.bytes - start_allocations.bytes };
+    profiler.add(zone, start, Profiler::now() - start, allocations);
+  }
+}
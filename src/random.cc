@@ -0,0 +1,53 @@
+#include "random.h"
+
+namespace {
+
+uint32_t rotl(uint32_t x, int k) {
+  return (x << k) | (x >> (32 - k));
+}
+
+// Spreads a seed over the state, as recommended by the xoshiro authors
+uint64_t splitmix64(uint64_t & x) {
+  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+}  // namespace
+
+Random::Random(uint64_t seed) {
+  this->seed(seed);
+}
+
+Random::~Random() {}
+
+void Random::seed(uint64_t seed) {
+  initial_seed = seed;
+  uint64_t x = seed;
+  for (int i = 0; i < 4; i += 2) {
+    uint64_t z = splitmix64(x);
+    state[i] = uint32_t(z);
+    state[i+1] = uint32_t(z >> 32);
+  }
+}
+
+uint64_t Random::get_seed() const {
+  return initial_seed;
+}
+
+uint32_t Random::next() {
+  uint32_t result = rotl(state[1] * 5, 7) * 9;
+  uint32_t t = state[1] << 9;
+  state[2] ^= state[0];
+  state[3] ^= state[1];
+  state[1] ^= state[2];
+  state[0] ^= state[3];
+  state[2] ^= t;
+  state[3] = rotl(state[3], 11);
+  return result;
+}
+
+int Random::next(int n) {
+  return int((uint64_t(next()) * uint32_t(n)) >> 32);
+}
@@ -0,0 +1,144 @@
+#include <iterator>
+#include "replay.h"
+#include "lane.h"
+
+namespace {
+
+void write_bytes(std::ofstream & file, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    file.put(char((value >> (8*i)) & 0xff));
+  }
+}
+
+uint64_t read_bytes(const uint8_t * data, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value |= uint64_t(data[i]) << (8*i);
+  }
+  return value;
+}
+
+const size_t header_size = 4 + 1 + 4 + 8 + 1;
+// Version 1 had no lane count, and always two lanes
+const size_t header_size_v1 = header_size - 1;
+
+}  // namespace
+
+Recorder::Recorder() : keys(0), count(0) {}
+
+Recorder::~Recorder() {
+  close();
+}
+
+bool Recorder::open(const std::string & path, int rate, uint64_t seed, int lanes) {
+  file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Error opening recording " << path << std::endl;
+    return false;
+  }
+  file.write(replay::magic, 4);
+  write_bytes(file, replay::version, 1);
+  write_bytes(file, rate, 4);
+  write_bytes(file, seed, 8);
+  write_bytes(file, lanes, 1);
+  keys = 0;
+  count = 0;
+  return true;
+}
+
+void Recorder::record(unsigned int keys) {
+  if (count > 0 and keys != this->keys) write_run();
+  this->keys = keys;
+  ++count;
+}
+
+void Recorder::close() {
+  if (!file.is_open()) return;
+  write_run();
+  file.close();
+}
+
+bool Recorder::is_open() const {
+  return file.is_open();
+}
+
+void Recorder::write_run() {
+  if (count == 0) return;
+  // Varint count, 7 bits per byte with the high bit set on all but the last
+  uint64_t value = count;
+  while (value >= 0x80) {
+    file.put(char((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  file.put(char(value));
+  write_bytes(file, keys, 2);
+  count = 0;
+}
+
+Replay::Replay() : offset(0), rate(0), seed(0), lanes(2), keys(0), count(0) {}
+
+Replay::~Replay() {}
+
+bool Replay::open(const std::string & path) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Error opening replay " << path << std::endl;
+    return false;
+  }
+  data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  if (data.size() < header_size_v1 or !std::equal(replay::magic, replay::magic+4, data.begin()) or
+      data[4] < 1 or data[4] > replay::version or (data[4] > 1 and data.size() < header_size)) {
+    std::cerr << "Not a recording: " << path << std::endl;
+    return false;
+  }
+  rate = int32_t(read_bytes(&data[5], 4));
+  seed = read_bytes(&data[9], 8);
+  lanes = data[4] > 1 ? data[17] : 2;
+  // As --rate and --lanes allow, anything else would replay another game
+  if (rate < 1 or lanes < 2 or lanes > Lane::max_lanes) {
+    std::cerr << "Not a recording: " << path << std::endl;
+    return false;
+  }
+  offset = data[4] > 1 ? header_size : header_size_v1;
+  count = 0;
+  return true;
+}
+
+int Replay::get_rate() const {
+  return rate;
+}
+
+uint64_t Replay::get_seed() const {
+  return seed;
+}
+
+int Replay::get_lanes() const {
+  return lanes;
+}
+
+bool Replay::next(unsigned int & keys) {
+  if (count == 0 and !read_run()) return false;
+  --count;
+  keys = this->keys;
+  return true;
+}
+
+bool Replay::read_run() {
+  uint64_t value = 0;
+  int shift = 0;
+  while (offset < data.size()) {
+    // A count takes at most 10 bytes, more is a corrupt file
+    if (shift >= 64) return false;
+    uint8_t byte = data[offset++];
+    value |= uint64_t(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) {
+      if (offset + 2 > data.size() or value == 0) return false;
+      keys = read_bytes(&data[offset], 2);
+      offset += 2;
+      count = value;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,427 @@
+#include "score_store.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t journal_magic = 0x4a43594b;  // "KYCJ"
+const uint32_t database_magic = 0x4443594b;  // "KYCD"
+const uint32_t database_version = 1;
+const int64_t seconds_per_day = 86400;
+
+struct JournalEntry {
+  uint32_t magic;
+  int32_t score;
+  float duration;
+  uint32_t reserved;
+  uint64_t id;
+  uint64_t seed;
+  int64_t timestamp;
+  // Checksum of the fields above
+  uint32_t crc;
+  uint32_t reserved2;
+};
+
+// The database is this header, the runs in time order, the indices of
+// the runs from best to worst score, and one DayIndex per day with runs
+struct DatabaseHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t last_id;
+  uint32_t count;
+  uint32_t num_days;
+  // Checksum of everything after the header
+  uint32_t crc;
+  uint32_t reserved;
+};
+
+struct DayIndex {
+  int32_t day;
+  uint32_t first;
+  uint32_t count;
+};
+
+uint32_t crc32(const void * data, size_t size) {
+  const uint8_t * bytes = static_cast<const uint8_t *>(data);
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < size; ++i) {
+    crc ^= bytes[i];
+    for (int k = 0; k < 8; ++k) {
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+int64_t day_of(int64_t timestamp) {
+  int64_t day = timestamp / seconds_per_day;
+  if (timestamp < 0 and timestamp % seconds_per_day != 0) --day;
+  return day;
+}
+
+bool write_all(int fd, const void * data, size_t size) {
+  const char * bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+const DatabaseHeader & get_header(const uint8_t * map) {
+  return *reinterpret_cast<const DatabaseHeader *>(map);
+}
+
+const ScoreStore::Run * get_mapped_runs(const uint8_t * map) {
+  return reinterpret_cast<const ScoreStore::Run *>(map + sizeof(DatabaseHeader));
+}
+
+const uint32_t * get_by_score(const uint8_t * map) {
+  return reinterpret_cast<const uint32_t *>(get_mapped_runs(map) + get_header(map).count);
+}
+
+const DayIndex * get_days(const uint8_t * map) {
+  return reinterpret_cast<const DayIndex *>(get_by_score(map) + get_header(map).count);
+}
+
+// Maps a database file, checking that it is complete and intact
+bool map_file(const std::string & file, const uint8_t *& map, size_t & size) {
+  int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0 and size_t(st.st_size) >= sizeof(DatabaseHeader);
+  void * data = MAP_FAILED;
+  if (ok) data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) return false;
+  const uint8_t * bytes = static_cast<const uint8_t *>(data);
+  const DatabaseHeader & header = get_header(bytes);
+  size_t expected = sizeof(DatabaseHeader) + header.count*(sizeof(ScoreStore::Run) + sizeof(uint32_t)) +
+                    header.num_days*sizeof(DayIndex);
+  if (header.magic != database_magic or header.version != database_version or
+      size_t(st.st_size) != expected or
+      header.crc != crc32(bytes + sizeof(DatabaseHeader), expected - sizeof(DatabaseHeader))) {
+    std::cerr << "Ignoring damaged score database " << file << std::endl;
+    munmap(data, st.st_size);
+    return false;
+  }
+  map = bytes;
+  size = st.st_size;
+  return true;
+}
+
+bool by_time(const ScoreStore::Run & a, const ScoreStore::Run & b) {
+  return a.timestamp < b.timestamp;
+}
+
+bool by_score(const ScoreStore::Run & a, const ScoreStore::Run & b) {
+  return a.score > b.score;
+}
+
+}  // namespace
+
+const int ScoreStore::compact_entries;
+
+ScoreStore::ScoreStore()
+  : journal_fd(-1), journal_entries(0), map(NULL), map_size(0), next_id(1), best_score(0),
+    written_id(0), stopping(false) {
+}
+
+ScoreStore::~ScoreStore() {
+  close();
+}
+
+bool ScoreStore::open(const std::string & path) {
+  close();
+  this->path = path;
+  stopping = false;
+  uint64_t last_id = 0;
+  if (map_file(path + ".db", map, map_size)) {
+    last_id = get_header(map).last_id;
+    if (get_header(map).count > 0) {
+      best_score = get_mapped_runs(map)[get_by_score(map)[0]].score;
+    }
+  }
+  next_id = last_id + 1;
+
+  journal_fd = ::open((path + ".journal").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (journal_fd < 0) {
+    std::cerr << "Error opening score journal " << path << ".journal" << std::endl;
+    return false;
+  }
+  load_journal();
+  written_id = next_id - 1;
+
+  // Carry over the best score kept by older versions
+  if (!map and tail.empty()) {
+    std::ifstream file("best_score.txt");
+    int legacy_best = 0;
+    if (file.is_open() and file >> legacy_best and legacy_best > 0) {
+      Run run = { legacy_best, 0.0f, 0, 0 };
+      add(run);
+    }
+  }
+
+  writer = std::thread(&ScoreStore::write_loop, this);
+  return true;
+}
+
+void ScoreStore::close() {
+  if (writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+  }
+  if (journal_fd >= 0) {
+    ::close(journal_fd);
+    journal_fd = -1;
+  }
+  if (map) {
+    munmap(const_cast<uint8_t *>(map), map_size);
+    map = NULL;
+  }
+  tail.clear();
+  queue.clear();
+  journal_entries = 0;
+}
+
+void ScoreStore::add(const Run & run) {
+  if (journal_fd < 0) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry = { next_id++, run };
+    tail.push_back(entry);
+    queue.push_back(entry);
+  }
+  wake.notify_one();
+  best_score = std::max(best_score, int(run.score));
+}
+
+void ScoreStore::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  written.wait(lock, [this] { return written_id + 1 >= next_id or !writer.joinable(); });
+}
+
+int ScoreStore::get_best_score() const {
+  return best_score;
+}
+
+std::vector<ScoreStore::Run> ScoreStore::get_top(int k) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Run> runs;
+  if (map) {
+    const DatabaseHeader & header = get_header(map);
+    for (uint32_t i = 0; i < header.count and int(i) < k; ++i) {
+      runs.push_back(get_mapped_runs(map)[get_by_score(map)[i]]);
+    }
+  }
+  for (const Entry & entry : tail) {
+    runs.push_back(entry.run);
+  }
+  std::stable_sort(runs.begin(), runs.end(), by_score);
+  if (int(runs.size()) > k) runs.resize(k);
+  return runs;
+}
+
+std::vector<ScoreStore::Run> ScoreStore::get_day(int64_t timestamp) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  int64_t day = day_of(timestamp);
+  std::vector<Run> runs;
+  if (map) {
+    const DayIndex * days = get_days(map);
+    const DayIndex * end = days + get_header(map).num_days;
+    const DayIndex * found = std::lower_bound(days, end, day,
+        [](const DayIndex & index, int64_t day) { return index.day < day; });
+    if (found != end and found->day == day) {
+      const Run * first = get_mapped_runs(map) + found->first;
+      runs.assign(first, first + found->count);
+    }
+  }
+  for (const Entry & entry : tail) {
+    if (day_of(entry.run.timestamp) == day) runs.push_back(entry.run);
+  }
+  std::stable_sort(runs.begin(), runs.end(), by_time);
+  return runs;
+}
+
+void ScoreStore::write_loop() {
+  std::vector<Entry> batch;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return stopping or !queue.empty(); });
+    batch.swap(queue);
+    bool stop = stopping;
+    lock.unlock();
+    if (!batch.empty()) {
+      write_journal(batch);
+      journal_entries += batch.size();
+      lock.lock();
+      written_id = batch.back().id;
+      lock.unlock();
+      written.notify_all();
+      batch.clear();
+    }
+    if (journal_entries >= compact_entries or (stop and journal_entries > 0)) {
+      compact();
+    }
+    lock.lock();
+    if (stop and queue.empty()) return;
+  }
+}
+
+bool ScoreStore::write_journal(const std::vector<Entry> & entries) {
+  std::vector<JournalEntry> records(entries.size());
+  for (unsigned int i = 0; i < entries.size(); ++i) {
+    JournalEntry & record = records[i];
+    memset(&record, 0, sizeof(record));
+    record.magic = journal_magic;
+    record.score = entries[i].run.score;
+    record.duration = entries[i].run.duration;
+    record.id = entries[i].id;
+    record.seed = entries[i].run.seed;
+    record.timestamp = entries[i].run.timestamp;
+    record.crc = crc32(&record, offsetof(JournalEntry, crc));
+  }
+  if (!write_all(journal_fd, records.data(), records.size()*sizeof(JournalEntry)) or
+      fdatasync(journal_fd) != 0) {
+    std::cerr << "Error writing score journal: " << strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool ScoreStore::compact() {
+  // Only the tail is copied under the lock, reading the mapping can wait on
+  // the disk and add() takes the same lock on the frame thread
+  std::vector<Run> runs;
+  uint64_t last_id;
+  const uint8_t * mapped;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Entry & entry : tail) {
+      runs.push_back(entry.run);
+    }
+    mapped = map;
+    last_id = next_id - 1;
+  }
+  // Only this thread replaces the mapping, so it stays valid meanwhile
+  if (mapped) {
+    const Run * first = get_mapped_runs(mapped);
+    runs.insert(runs.begin(), first, first + get_header(mapped).count);
+  }
+  std::stable_sort(runs.begin(), runs.end(), by_time);
+  std::vector<uint32_t> order(runs.size());
+  for (unsigned int i = 0; i < order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+                   [&runs](uint32_t a, uint32_t b) { return runs[a].score > runs[b].score; });
+  std::vector<DayIndex> days;
+  for (unsigned int i = 0; i < runs.size(); ++i) {
+    int32_t day = day_of(runs[i].timestamp);
+    if (days.empty() or days.back().day != day) {
+      DayIndex index = { day, i, 0 };
+      days.push_back(index);
+    }
+    ++days.back().count;
+  }
+
+  std::vector<uint8_t> body(runs.size()*(sizeof(Run) + sizeof(uint32_t)) + days.size()*sizeof(DayIndex));
+  uint8_t * out = body.data();
+  if (!runs.empty()) memcpy(out, runs.data(), runs.size()*sizeof(Run));
+  out += runs.size()*sizeof(Run);
+  if (!order.empty()) memcpy(out, order.data(), order.size()*sizeof(uint32_t));
+  out += order.size()*sizeof(uint32_t);
+  if (!days.empty()) memcpy(out, days.data(), days.size()*sizeof(DayIndex));
+  DatabaseHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = database_magic;
+  header.version = database_version;
+  header.last_id = last_id;
+  header.count = runs.size();
+  header.num_days = days.size();
+  header.crc = crc32(body.data(), body.size());
+
+  // Write aside and rename, so the database on disk is always complete
+  std::string file = path + ".db", temporary = path + ".db.tmp";
+  int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool ok = fd >= 0 and write_all(fd, &header, sizeof(header)) and
+            write_all(fd, body.data(), body.size()) and fsync(fd) == 0;
+  if (fd >= 0) ::close(fd);
+  ok = ok and rename(temporary.c_str(), file.c_str()) == 0;
+  if (!ok) {
+    std::cerr << "Error compacting scores: " << strerror(errno) << std::endl;
+    unlink(temporary.c_str());
+    return false;
+  }
+  size_t slash = path.rfind('/');
+  std::string directory = slash == std::string::npos ? "." : path.substr(0, std::max(size_t(1), slash));
+  int directory_fd = ::open(directory.c_str(), O_RDONLY);
+  if (directory_fd >= 0) {
+    fsync(directory_fd);
+    ::close(directory_fd);
+  }
+
+  const uint8_t * new_map = NULL;
+  size_t new_size = 0;
+  if (!map_file(file, new_map, new_size)) return false;
+  const uint8_t * old_map;
+  size_t old_size;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    old_map = map;
+    old_size = map_size;
+    map = new_map;
+    map_size = new_size;
+    std::vector<Entry> rest;
+    for (const Entry & entry : tail) {
+      if (entry.id > last_id) rest.push_back(entry);
+    }
+    tail.swap(rest);
+  }
+  if (old_map) munmap(const_cast<uint8_t *>(old_map), old_size);
+
+  // Entries up to last_id are in the database now, and skipped if a crash
+  // leaves them in the journal
+  if (ftruncate(journal_fd, 0) == 0) fdatasync(journal_fd);
+  journal_entries = 0;
+  return true;
+}
+
+void ScoreStore::load_journal() {
+  uint64_t last_id = next_id - 1;
+  std::vector<JournalEntry> records;
+  JournalEntry record;
+  off_t valid = 0;
+  lseek(journal_fd, 0, SEEK_SET);
+  while (read(journal_fd, &record, sizeof(record)) == ssize_t(sizeof(record))) {
+    if (record.magic != journal_magic or record.crc != crc32(&record, offsetof(JournalEntry, crc))) {
+      break;
+    }
+    valid += sizeof(record);
+    ++journal_entries;
+    if (record.id <= last_id) continue;
+    Run run = { record.score, record.duration, record.seed, record.timestamp };
+    Entry entry = { record.id, run };
+    tail.push_back(entry);
+    next_id = std::max(next_id, record.id + 1);
+    best_score = std::max(best_score, int(record.score));
+  }
+  // Drop a torn write left by a crash, so new entries follow valid ones
+  if (lseek(journal_fd, 0, SEEK_END) != valid) {
+    if (ftruncate(journal_fd, valid) != 0) {
+      std::cerr << "Error repairing score journal: " << strerror(errno) << std::endl;
+    }
+  }
+}
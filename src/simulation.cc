@@ -0,0 +1,534 @@
+#include "simulation.h"
+#include "lane.h"
+#include "utils.h"
+#include "player.h"
+#include "profiler.h"
+
+const int Simulation::num_positions = 8;
+const float Simulation::ready_speed = 1000.0f;
+const float Simulation::game_over_speed = 200.0f;
+const float Simulation::walls_min_height = 180.0f; 
+const float Simulation::rebase_distance = 65536.0f;
+const int Simulation::entity_capacity = 1024;
+const float Simulation::spawn_interval = 1.0f;
+const float Simulation::entity_size = 12.0f;
+const float Simulation::pickup_score = 100.0f;
+
+namespace {
+
+// Heights the walls of a lane move towards
+const float target_position_values[] = { 0.0f, 50.0f, 100.0f, 150.0f, 200.0f, 250.0f, 300.0f, 350.0f };
+
+}  // namespace
+
+Simulation::Settings::Settings() {
+  num_types = 2;
+  walls_width = 4.0f;
+  start_speed = 300.0f;
+  walls_max_dist = 3;
+  init_one_way_probability = 20;
+  init_walls_next_target_timeout = 2.0f;
+  min_walls_next_target_timeout = 0.5f;
+  generator_thread = false;
+}
+
+Simulation::Simulation(const Settings & settings)
+  : num_types(std::max(1, std::min(Lane::max_lanes, settings.num_types))), walls_width(settings.walls_width),
+    // Columns on screen plus the ones scrolling in and out
+    lane_capacity(int(SCREEN_WIDTH/settings.walls_width) + 4),
+    start_speed(settings.start_speed), walls_max_dist(settings.walls_max_dist),
+    init_one_way_probability(settings.init_one_way_probability),
+    init_walls_next_target_timeout(settings.init_walls_next_target_timeout),
+    min_walls_next_target_timeout(settings.min_walls_next_target_timeout),
+    target_positions(target_position_values, target_position_values + num_positions),
+    course(get_course_config(), settings.generator_thread), course_generation(0), entities(entity_capacity) {
+  one_way_probability = init_one_way_probability;
+  status = MENU;
+  score = 0;
+  last_score = 0;
+  total_time = 0;
+  time_to_start = 0;
+  play_time = 0;
+  player = NULL;
+}
+
+Simulation::~Simulation() {
+  clear();
+}
+
+void Simulation::init(uint64_t seed) {
+  clear();
+  course.stop();
+  ++course_generation;
+  rng.seed(seed);
+  entity_rng.seed(seed ^ 0x9e3779b97f4a7c15ULL);
+  entities.clear();
+  spawn_timer = spawn_interval;
+  speed = target_speed = start_speed;
+
+  // Lanes from an earlier run are emptied rather than replaced, so their
+  // column counts go on and copies tracking them see the columns go
+  if (lanes.empty()) {
+    for (int type = 0; type < num_types; ++type) {
+      lanes.push_back(Lane(type, walls_width, lane_capacity));
+    }
+  }
+  for (Lane & lane : lanes) {
+    lane.clear();
+  }
+
+  walls_next_target_timeout = init_walls_next_target_timeout;
+  walls_next_target_timer = walls_next_target_timeout;
+  walls_last_target = walls_target = walls_next_target = std::vector<int>(num_types);
+  
+  for (int type = 0; type < num_types; ++type) {
+    walls_target[type] = walls_next_target[type] =  rng.next(num_positions);
+  }
+  
+  scroll = last_scroll = 0.0f;
+  player = (new Player(*this, 0, 1000.0f));
+
+  // Assign initial status update, which is menu_update
+  status_update = &Simulation::menu_update;
+}
+
+void Simulation::update(float delta_time, unsigned int keys) {
+  last_scroll = scroll;
+  player->save_pos();
+  input.update(keys);
+  total_time += delta_time;
+
+  // Speed moves to target, walls stay in place and the camera moves
+  if (CourseGenerator::move(delta_time, target_speed, rebase_distance, speed, scroll)) rebase();
+  entities.update(delta_time, scroll);
+
+  // Update specific for current status
+  (this->*status_update)(delta_time);
+  // Delete old walls, after the player has been swept over them
+  erase_old_walls();
+}
+
+const Input & Simulation::get_input() const {
+  return input;
+}
+
+uint64_t Simulation::get_seed() const {
+  return rng.get_seed();
+}
+
+int Simulation::get_status() const {
+  return status;
+}
+
+float Simulation::get_score() const {
+  return score;
+}
+
+float Simulation::get_last_score() const {
+  return last_score;
+}
+
+float Simulation::get_time_to_start() const {
+  return time_to_start;
+}
+
+float Simulation::get_play_time() const {
+  return play_time;
+}
+
+float Simulation::get_scroll() const {
+  return scroll;
+}
+
+float Simulation::get_scroll(float alpha) const {
+  return last_scroll + (scroll - last_scroll)*alpha;
+}
+
+const std::vector<Lane> & Simulation::get_lanes() const {
+  return lanes;
+}
+
+const Entities & Simulation::get_entities() const {
+  return entities;
+}
+
+const Player & Simulation::get_player() const {
+  return *player;
+}
+
+namespace {
+
+// FNV-1a over the bytes of a value
+template <typename T>
+void hash_value(uint64_t & hash, const T & value) {
+  const unsigned char * bytes = reinterpret_cast<const unsigned char *>(&value);
+  for (unsigned int i = 0; i < sizeof(T); ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+}
+
+}  // namespace
+
+uint64_t Simulation::get_hash() const {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  hash_value(hash, status);
+  hash_value(hash, score);
+  hash_value(hash, speed);
+  hash_value(hash, scroll);
+  hash_value(hash, player->get_type());
+  hash_value(hash, player->get_pos().y);
+  hash_value(hash, entities.size());
+  for (const Lane & lane : lanes) {
+    hash_value(hash, lane.get_end());
+    if (lane.empty()) continue;
+    int last = lane.size()-1;
+    hash_value(hash, lane.get_y(last));
+    hash_value(hash, lane.get_height(last));
+  }
+  return hash;
+}
+
+//** STATUS DEPENDENT UPDATE **
+void Simulation::menu_update(float delta_time) {
+  ProfileZone zone(Profiler::MENU_UPDATE);
+  generate_menu_walls();
+
+  if (input.key_pressed(input.Key::PLAYER_ACTION)) {
+      status = READY;
+      status_update = &Simulation::ready_update;
+      time_to_start = 3.0f;
+  }
+}
+
+void Simulation::ready_update(float delta_time) {
+  ProfileZone zone(Profiler::READY_UPDATE);
+  generate_ready_walls();
+
+  if (player->get_type() != 0) player->set_type(0);
+  target_speed = ready_speed;
+  if (time_to_start < 2.5f) {
+    target_speed = start_speed;
+    one_way_probability = init_one_way_probability;
+    walls_next_target_timeout = init_walls_next_target_timeout;
+    for (int type = 0; type < num_types; ++type) {
+      walls_target[type] = walls_next_target[type] = rng.next(num_positions);
+    }
+  }
+
+  // Move player to initial position
+  sf::Vector2f pos = player->get_pos();
+  sf::Vector2f size = player->get_size();
+  player->set_pos(sf::Vector2f(pos.x,
+                               pos.y + ((SCREEN_HEIGHT/2.0f-size.y/2.0) - pos.y)*delta_time*2));
+
+  // Adjust speed
+  time_to_start -= delta_time;
+  if (time_to_start < 0.0f) {
+    status = PLAYING;
+    status_update = &Simulation::playing_update;
+    // The lanes were generated otherwise until now
+    ++course_generation;
+    play_time = 0;
+    entities.clear();
+    spawn_timer = spawn_interval;
+  }
+}
+
+void Simulation::playing_update(float delta_time) {
+  ProfileZone zone(Profiler::PLAYING_UPDATE);
+  generate_game_walls(delta_time);
+  spawn_entities(delta_time);
+
+  score += delta_time*100;
+  play_time += delta_time;
+  CourseGenerator::speed_up(delta_time, target_speed);
+
+  int start_type = player->get_type();
+  player->update(delta_time);
+  sf::Vector2f pos = player->get_pos();
+  Entities::Hits hits = entities.collide(sf::Vector2f(pos.x + scroll, pos.y), player->get_size());
+  score += hits.pickups*pickup_score;
+  if (hits.gate_type >= 0) player->set_type(hits.gate_type);
+  // Changing color, by action or through a gate, moves the player to
+  // another lane, only the end counts
+  bool swept = (player->get_type() == start_type);
+  if (hits.blocked or !player_inside(swept)) {
+    status = GAME_OVER;
+    status_update = &Simulation::game_over_update;
+    target_speed = game_over_speed;
+    last_score = score;
+    course.stop();
+  } 
+}
+
+void Simulation::game_over_update(float delta_time) {
+  ProfileZone zone(Profiler::GAME_OVER_UPDATE);
+  generate_walls();
+  score = 0;
+  if (input.key_pressed(input.Key::PLAYER_ACTION)) {
+    status = READY;
+    status_update = &Simulation::ready_update;
+    time_to_start = 3.0f;
+  }
+}
+//** END STATUS DEPENDENT UPDATE
+
+void Simulation::clear() {
+  delete player;
+  player = NULL;
+}
+
+CourseGenerator::Config Simulation::get_course_config() const {
+  CourseGenerator::Config config;
+  config.num_types = num_types;
+  config.walls_width = walls_width;
+  config.lane_capacity = lane_capacity;
+  config.walls_max_dist = walls_max_dist;
+  config.min_walls_next_target_timeout = min_walls_next_target_timeout;
+  config.walls_min_height = walls_min_height;
+  config.rebase_distance = rebase_distance;
+  config.target_positions = target_positions;
+  return config;
+}
+
+void Simulation::generate_game_walls(float delta_time) {
+  CourseGenerator::State state;
+  state.speed = speed;
+  state.target_speed = target_speed;
+  state.scroll = scroll;
+  state.walls_next_target_timeout = walls_next_target_timeout;
+  state.walls_next_target_timer = walls_next_target_timer;
+  state.one_way_probability = one_way_probability;
+  for (int type = 0; type < num_types; ++type) {
+    state.walls_target[type] = walls_target[type];
+    state.walls_next_target[type] = walls_next_target[type];
+    state.walls_last_target[type] = walls_last_target[type];
+  }
+  state.rng = rng;
+
+  course.take_step(course_generation, delta_time, state, lanes);
+
+  // The difficulty and targets after the step come back with its columns
+  walls_next_target_timeout = state.walls_next_target_timeout;
+  walls_next_target_timer = state.walls_next_target_timer;
+  one_way_probability = state.one_way_probability;
+  for (int type = 0; type < num_types; ++type) {
+    walls_target[type] = state.walls_target[type];
+    walls_next_target[type] = state.walls_next_target[type];
+    walls_last_target[type] = state.walls_last_target[type];
+  }
+  rng = state.rng;
+}
+
+void Simulation::generate_ready_walls() {
+  for (int type = 0; type < num_types; ++type) {
+    Lane & lane = lanes[type];
+    float diff = walls_width;
+    if (type > 0) diff *= -1;
+    if (lane.empty() and type > 0) {
+      continue;
+    }
+    if (lane.empty() and type == 0) {
+      lane.push_back(scroll + SCREEN_WIDTH, SCREEN_HEIGHT/2.0f, 5.0f);
+    }
+    int last = lane.size()-1;
+    float last_x = lane.get_x(last) + walls_width;
+    float last_y = lane.get_y(last);
+    float last_height = lane.get_height(last);
+    while (last_x < scroll + SCREEN_WIDTH) {
+      float new_y = std::max(0.0f, std::min(SCREEN_HEIGHT - walls_width, last_y-diff/2.0f));
+      float new_height = last_height + diff;
+      new_height = std::max(0.0f, std::min(new_height, SCREEN_HEIGHT - new_y));
+      lane.push_back(last_x, new_y, new_height);
+      last_height = new_height;
+      last_x = last_x + walls_width;
+      last_y = new_y;
+    }
+  }
+}
+
+void Simulation::generate_menu_walls() {
+  float size = 100.0f;
+  float sin_diff = 30.0f;
+  float y_offset = std::min(100.0f, SCREEN_HEIGHT/(num_types+1.0f));
+  for (int type = 0; type < num_types; ++type) {
+    Lane & lane = lanes[type];
+    float diff = sin_diff * sin(total_time * (1.337f * (type+1)));
+    float pos_y = y_offset*(type+1) + diff;
+    if (lane.empty()) {
+      lane.push_back(scroll + SCREEN_WIDTH, pos_y, 5.0f);
+    }
+    // Heights grow linearly up to size
+    int count = get_missing_columns(lane);
+    while (count > 0) {
+      int last = lane.size()-1;
+      float last_x = lane.get_x(last);
+      float last_height = lane.get_height(last);
+      float *x, *y, *height;
+      int n = lane.get_back_segment(count, x, y, height);
+      CourseGenerator::fill_linear(x, n, last_x, walls_width);
+      std::fill(y, y + n, pos_y);
+      CourseGenerator::fill_linear(height, n, last_height, walls_width/2.0f);
+      for (int k = 0; k < n; ++k) {
+        height[k] = std::min(height[k], size);
+      }
+      lane.commit_back(n);
+      count -= n;
+    }
+  }
+}
+
+void Simulation::generate_walls() {
+  for (int type = 0; type < num_types; ++type) {
+    Lane & lane = lanes[type];
+    if (!lane.empty()) {
+      int last = lane.size()-1;
+      float last_y = lane.get_y(last);
+      float last_height = lane.get_height(last);
+      float last_x = lane.get_x(last) + walls_width;
+      while (last_x < scroll + SCREEN_WIDTH) {
+        // One draw per statement, so the order is the same on every compiler
+        int y_diff = rng.next(int(walls_width));
+        float new_y = last_y + y_diff*(rng.next(2) ? -1:1);
+        int height_diff = rng.next(int(walls_width));
+        float new_height = last_height + height_diff*(rng.next(2) ? -1:1);
+        new_height = std::max(walls_min_height, std::min(SCREEN_HEIGHT - new_y, new_height));
+        // limit new height
+        new_height = std::min(new_height, last_height + walls_width/2.0f);
+        // limit new y
+        new_y = std::max(0.0f, std::min(SCREEN_HEIGHT - new_height, new_y));
+        lane.push_back(last_x, new_y, new_height);
+
+        last_x += walls_width;
+        last_y = new_y;
+        last_height = new_height;
+      }
+    }
+    else {
+      lane.push_back(scroll + SCREEN_WIDTH, 0, 50);
+    }
+  }
+}
+
+void Simulation::spawn_entities(float delta_time) {
+  spawn_timer -= delta_time;
+  if (spawn_timer > 0.0f) return;
+  spawn_timer += spawn_interval;
+  int type = entity_rng.next(num_types);
+  int kind = entity_rng.next(4);
+  const Lane & lane = lanes[type];
+  if (lane.empty()) return;
+  int last = lane.size()-1;
+  float x = lane.get_x(last), y = lane.get_y(last), height = lane.get_height(last);
+  // Skip closing paths, there is no room
+  if (height < 3*entity_size) return;
+  if (kind < 2) {
+    entities.spawn(Entities::PICKUP, type, x, y + (height - entity_size)/2.0f,
+                   entity_size, entity_size);
+  }
+  else if (kind == 2) {
+    // Across the lane, so passing it takes the lane's color
+    entities.spawn(Entities::GATE, type, x, y, walls_width, height);
+  }
+  else {
+    Entities::Handle blocker = entities.spawn(Entities::BLOCKER, type, x, y, entity_size/2.0f,
+                                              entity_size);
+    entities.set_motion(blocker, 60.0f + entity_rng.next(60), y, y + height - entity_size);
+  }
+}
+
+int Simulation::get_missing_columns(const Lane & lane) const {
+  // Columns follow the last one until one starts past the screen's right edge
+  float first_x = lane.get_x(lane.size()-1) + walls_width;
+  float right = scroll + SCREEN_WIDTH;
+  if (first_x >= right) return 0;
+  return int(std::ceil((right - first_x)/walls_width));
+}
+
+void Simulation::erase_old_walls() {
+  erase_walls_before(scroll);
+}
+
+void Simulation::erase_walls_before(float x) {
+  for (int type = 0; type < num_types; ++type) {
+    Lane & lane = lanes[type];
+    bool move_next = true;
+    while (!lane.empty() and move_next) { 
+      float last_x = lane.get_x(0) + walls_width;
+      move_next = (last_x <= x);
+      if (move_next) {
+        lane.pop_front();
+      }
+    }
+  }
+}
+
+void Simulation::rebase() {
+  // rebase_distance is a power of two and columns lie near it, so
+  // subtracting it is exact and the course does not change
+  scroll -= rebase_distance;
+  last_scroll -= rebase_distance;
+  for (Lane & lane : lanes) {
+    lane.shift(-rebase_distance);
+  }
+  entities.shift(-rebase_distance);
+}
+
+unsigned int Simulation::get_coverage() const {
+  // The player stays on screen, lanes are in world coordinates
+  sf::Vector2f pos = player->get_pos();
+  return Lane::get_coverage(lanes, sf::Vector2f(pos.x + scroll, pos.y), player->get_size());
+}
+
+bool Simulation::player_inside(bool swept) {
+  if (!((get_coverage() >> player->get_type()) & 1)) return false;
+  if (!swept) return true;
+  // The whole move since the last step, so a long step or a high speed
+  // cannot carry the player through a gap narrower than the move
+  sf::Vector2f from = player->get_pos(0.0f);
+  sf::Vector2f to = player->get_pos();
+  return lanes[player->get_type()].contains_swept(sf::Vector2f(from.x + last_scroll, from.y),
+                                                  sf::Vector2f(to.x + scroll, to.y),
+                                                  player->get_size());
+}
+
+void Simulation::start_playing(float speed) {
+  status = PLAYING;
+  status_update = &Simulation::playing_update;
+  this->speed = target_speed = speed;
+  player->set_speed(speed);
+  ++course_generation;
+}
+
+void Simulation::restart_lanes() {
+  for (Lane & lane : lanes) {
+    float y = 0.0f, height = 0.0f;
+    if (!lane.empty()) {
+      y = lane.get_y(lane.size()-1);
+      height = lane.get_height(lane.size()-1);
+    }
+    lane.clear();
+    lane.push_back(scroll, y, height);
+  }
+  ++course_generation;
+}
+
+void Simulation::generate_course(float delta_time) {
+  generate_game_walls(delta_time);
+}
+
+void Simulation::get_lane_target(int type, float & y, float & height, float & time_left) const {
+  int target = walls_target[type];
+  y = target_positions[std::abs(target)];
+  height = target < 0 ? 0.0f : walls_min_height;
+  time_left = walls_next_target_timer;
+}
+
+float Simulation::get_speed() const {
+  return speed;
+}
+
+void Simulation::update_player(float delta_time, unsigned int keys) {
+  input.update(keys);
+  player->update(delta_time);
+}
@@ -0,0 +1,369 @@
+#include "software_renderer.h"
+#include "simulation.h"
+#include "actor.h"
+#include <cctype>
+#include <cstdio>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 5x7 glyphs of ASCII 32 to 95, one byte per row, top to bottom, with the
+// leftmost pixel in bit 4. Characters without a glyph are left blank
+const uint8_t font[64][7] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // ' '
+  { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 },  // !
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // "
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // #
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // $
+  { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },  // %
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // &
+  { 0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 },  // '
+  { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },  // (
+  { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },  // )
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // *
+  { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 },  // +
+  { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 },  // ,
+  { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },  // -
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },  // .
+  { 0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x10 },  // /
+  { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },  // 0
+  { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },  // 1
+  { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },  // 2
+  { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },  // 3
+  { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },  // 4
+  { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },  // 5
+  { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },  // 6
+  { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },  // 7
+  { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },  // 8
+  { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },  // 9
+  { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },  // :
+  { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 },  // ;
+  { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },  // <
+  { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },  // =
+  { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },  // >
+  { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },  // ?
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },  // @
+  { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 },  // A
+  { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },  // B
+  { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },  // C
+  { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },  // D
+  { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },  // E
+  { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },  // F
+  { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },  // G
+  { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },  // H
+  { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },  // I
+  { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },  // J
+  { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },  // K
+  { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },  // L
+  { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },  // M
+  { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },  // N
+  { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },  // O
+  { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },  // P
+  { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },  // Q
+  { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },  // R
+  { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },  // S
+  { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },  // T
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },  // U
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },  // V
+  { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },  // W
+  { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },  // X
+  { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },  // Y
+  { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },  // Z
+  { 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E },  // [
+  { 0x10, 0x10, 0x08, 0x04, 0x02, 0x01, 0x01 },  // backslash
+  { 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E },  // ]
+  { 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00 },  // ^
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F },  // _
+};
+const int glyph_width = 5;
+const int glyph_height = 7;
+
+// Pixels are stored as RGBA bytes, which is this value on little-endian machines
+uint32_t pack(const sf::Color & color) {
+  return uint32_t(color.r) | uint32_t(color.g) << 8 | uint32_t(color.b) << 16 | uint32_t(color.a) << 24;
+}
+
+// x/255 rounded down, for x up to 255*255
+uint32_t div255(uint32_t x) {
+  return (x + 1 + (x >> 8)) >> 8;
+}
+
+// First pixel whose center is at or past x
+int pixel_edge(float x) {
+  return int(std::ceil(x - 0.5f));
+}
+
+// Blends a color over pixels, out = (color*a + pixel*(255 - a))/255 per
+// channel. The alpha channel blends towards 255, so pixels stay opaque
+struct Blend {
+  Blend() {}
+  Blend(const sf::Color & color)
+    : inverse(255 - color.a), r(color.r*color.a), g(color.g*color.a), b(color.b*color.a),
+      alpha(255*color.a) {
+#ifdef __SSE2__
+    // Two pixels of 16 bit channels
+    source = _mm_setr_epi16(int16_t(r), int16_t(g), int16_t(b), int16_t(alpha),
+                            int16_t(r), int16_t(g), int16_t(b), int16_t(alpha));
+    factor = _mm_set1_epi16(int16_t(inverse));
+#endif
+  }
+  uint32_t apply(uint32_t pixel) const {
+    return div255(r + (pixel & 0xff)*inverse) | div255(g + (pixel >> 8 & 0xff)*inverse) << 8 |
+           div255(b + (pixel >> 16 & 0xff)*inverse) << 16 | div255(alpha + (pixel >> 24)*inverse) << 24;
+  }
+#ifdef __SSE2__
+  // Same as above for four pixels, the sums fit in 16 bits unsigned
+  __m128i apply(__m128i pixels) const {
+    const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi16(1);
+    __m128i low = _mm_unpacklo_epi8(pixels, zero);
+    __m128i high = _mm_unpackhi_epi8(pixels, zero);
+    low = _mm_add_epi16(_mm_mullo_epi16(low, factor), source);
+    high = _mm_add_epi16(_mm_mullo_epi16(high, factor), source);
+    low = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(low, one), _mm_srli_epi16(low, 8)), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(high, one), _mm_srli_epi16(high, 8)), 8);
+    return _mm_packus_epi16(low, high);
+  }
+  __m128i source;
+  __m128i factor;
+#endif
+  uint32_t inverse;
+  uint32_t r, g, b, alpha;
+};
+
+// Writes row y of the lanes. Lane type covers the pixels at x where
+// tops[type*count + x] <= y < bottoms[type*count + x], and each pixel takes
+// the color of the set of lanes covering it, colors[sum of 1 << type]
+void write_row(uint32_t * row, int count, int y, const int16_t * tops, const int16_t * bottoms,
+               const int * lanes, int num_lanes, const uint32_t * colors) {
+  int x = 0;
+#ifdef __SSE2__
+  const __m128i row_y = _mm_set1_epi16(int16_t(y));
+  uint16_t pixel_sets[8];
+  for (; x + 8 <= count; x += 8) {
+    // Lane set of each of the eight pixels, and of the whole block if it is uniform
+    __m128i sets = _mm_setzero_si128();
+    int block_set = 0;
+    bool uniform = true;
+    for (int k = 0; k < num_lanes; ++k) {
+      int offset = lanes[k]*count + x;
+      __m128i lane_tops = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tops + offset));
+      __m128i lane_bottoms = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottoms + offset));
+      __m128i covered = _mm_andnot_si128(_mm_cmpgt_epi16(lane_tops, row_y),
+                                         _mm_cmpgt_epi16(lane_bottoms, row_y));
+      sets = _mm_or_si128(sets, _mm_and_si128(covered, _mm_set1_epi16(int16_t(1 << lanes[k]))));
+      int mask = _mm_movemask_epi8(covered);
+      if (mask == 0xffff) block_set |= 1 << lanes[k];
+      else if (mask != 0) uniform = false;
+    }
+    __m128i * p = reinterpret_cast<__m128i *>(row + x);
+    if (uniform) {
+      __m128i color = _mm_set1_epi32(int32_t(colors[block_set]));
+      _mm_storeu_si128(p, color);
+      _mm_storeu_si128(p + 1, color);
+      continue;
+    }
+    // Only blocks on the edge of a lane look up each pixel
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pixel_sets), sets);
+    for (int i = 0; i < 8; ++i) {
+      row[x + i] = colors[pixel_sets[i]];
+    }
+  }
+#endif
+  for (; x < count; ++x) {
+    int set = 0;
+    for (int k = 0; k < num_lanes; ++k) {
+      int offset = lanes[k]*count + x;
+      if (tops[offset] <= y and y < bottoms[offset]) set |= 1 << lanes[k];
+    }
+    row[x] = colors[set];
+  }
+}
+
+}  // namespace
+
+SoftwareRenderer::SoftwareRenderer(int width, int height)
+  : width(width), height(height), pixels(width*height) {
+}
+
+SoftwareRenderer::~SoftwareRenderer() {}
+
+void SoftwareRenderer::render(const Simulation & simulation) {
+  // Lanes and entities are in world coordinates, the player on screen
+  float scroll = simulation.get_scroll();
+  render_lanes(simulation.get_lanes(), scroll, sf::Color::White);
+  const Entities & entities = simulation.get_entities();
+  for (int kind = 0; kind < Entities::K_SIZE; ++kind) {
+    const Entities::Group & group = entities.get_group(Entities::Kind(kind));
+    for (int i = 0; i < group.count; ++i) {
+      float left = group.x[i] - scroll;
+      fill_rect(left, group.y[i], left + group.width[i], group.y[i] + group.height[i],
+                Entities::get_color(Entities::Kind(kind), group.type[i]));
+    }
+  }
+  const Player & player = simulation.get_player();
+  sf::Vector2f pos = player.get_pos(), size = player.get_size();
+  fill_rect(pos.x, pos.y, pos.x + size.x, pos.y + size.y, Actor::colors[player.get_type()]);
+
+  // Formatted on the stack, so rendering a frame does not allocate
+  char hud[128];
+  switch (simulation.get_status()) {
+    case Simulation::MENU:
+      snprintf(hud, sizeof(hud), "Keep your color");
+      break;
+    case Simulation::READY:
+      snprintf(hud, sizeof(hud), "Game starts in: %d", int(simulation.get_time_to_start())+1);
+      break;
+    case Simulation::PLAYING:
+      snprintf(hud, sizeof(hud), "Score: %d", int(simulation.get_score()));
+      break;
+    default:
+      snprintf(hud, sizeof(hud), "Game over\nScore: %d\nSeed: %llu", int(simulation.get_last_score()),
+               (unsigned long long)simulation.get_seed());
+  }
+  draw_text(4.0f, 4.0f, hud, 3, sf::Color::Black);
+}
+
+void SoftwareRenderer::clear(const sf::Color & color) {
+  std::fill(pixels.begin(), pixels.end(), pack(color));
+}
+
+void SoftwareRenderer::fill_rect(float left, float top, float right, float bottom,
+                                 const sf::Color & color) {
+  int x0 = std::max(0, pixel_edge(left)), x1 = std::min(width, pixel_edge(right));
+  int y0 = std::max(0, pixel_edge(top)), y1 = std::min(height, pixel_edge(bottom));
+  if (x0 >= x1 or color.a == 0) return;
+  for (int y = y0; y < y1; ++y) {
+    fill_span(&pixels[y*width + x0], x1 - x0, color);
+  }
+}
+
+void SoftwareRenderer::draw_text(float x, float y, const char * text, int scale,
+                                 const sf::Color & color) {
+  float pen_x = x;
+  for (; *text; ++text) {
+    char c = *text;
+    if (c == '\n') {
+      pen_x = x;
+      y += (glyph_height + 3)*scale;
+      continue;
+    }
+    int index = std::toupper((unsigned char)c) - ' ';
+    if (index >= 0 and index < 64) {
+      for (int row = 0; row < glyph_height; ++row) {
+        uint8_t bits = font[index][row];
+        float top = y + row*scale;
+        // Each run of set bits in a row is one rectangle
+        for (int column = 0; column < glyph_width; ) {
+          if (!(bits & (0x10 >> column))) {
+            ++column;
+            continue;
+          }
+          int start = column;
+          while (column < glyph_width and (bits & (0x10 >> column))) ++column;
+          fill_rect(pen_x + start*scale, top, pen_x + column*scale, top + scale, color);
+        }
+      }
+    }
+    pen_x += (glyph_width + 1)*scale;
+  }
+}
+
+int SoftwareRenderer::get_width() const {
+  return width;
+}
+
+int SoftwareRenderer::get_height() const {
+  return height;
+}
+
+const uint8_t * SoftwareRenderer::get_pixels() const {
+  return reinterpret_cast<const uint8_t *>(pixels.data());
+}
+
+uint64_t SoftwareRenderer::get_hash() const {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (uint32_t pixel : pixels) {
+    hash = (hash ^ pixel)*0x100000001b3ULL;
+  }
+  return hash;
+}
+
+bool SoftwareRenderer::save(const std::string & path) const {
+  sf::Image image;
+  image.create(width, height, get_pixels());
+  if (!image.saveToFile(path)) {
+    std::cerr << "Error writing image " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void SoftwareRenderer::render_lanes(const std::vector<Lane> & lanes, float scroll,
+                                    const sf::Color & background) {
+  int num_lanes = lanes.size();
+  // Lanes are blended in order, so the color of a set of lanes is the
+  // color of the set without its last lane with that lane blended over it
+  if (lane_colors.size() != 1u << num_lanes or lane_colors[0] != pack(background)) {
+    lane_colors.resize(1u << num_lanes);
+    lane_colors[0] = pack(background);
+    for (int type = 0; type < num_lanes; ++type) {
+      sf::Color color = Actor::colors[lanes[type].get_type()];
+      color.a = 80;
+      Blend blend(color);
+      for (int set = 1 << type; set < 2 << type; ++set) {
+        lane_colors[set] = blend.apply(lane_colors[set - (1 << type)]);
+      }
+    }
+  }
+
+  lane_tops.assign(num_lanes*width, 0);
+  lane_bottoms.assign(num_lanes*width, 0);
+  int first_rows[Lane::max_lanes], end_rows[Lane::max_lanes];
+  for (int type = 0; type < num_lanes; ++type) {
+    const Lane & lane = lanes[type];
+    first_rows[type] = height;
+    end_rows[type] = 0;
+    int16_t * tops = &lane_tops[type*width];
+    int16_t * bottoms = &lane_bottoms[type*width];
+    for (int i = 0; i < lane.size(); ++i) {
+      float left = lane.get_x(i) - scroll;
+      int x0 = std::max(0, pixel_edge(left)), x1 = std::min(width, pixel_edge(left + lane.get_width()));
+      int y0 = std::max(0, pixel_edge(lane.get_y(i)));
+      int y1 = std::min(height, pixel_edge(lane.get_y(i) + lane.get_height(i)));
+      if (x0 >= x1 or y0 >= y1) continue;
+      std::fill(tops + x0, tops + x1, int16_t(y0));
+      std::fill(bottoms + x0, bottoms + x1, int16_t(y1));
+      first_rows[type] = std::min(first_rows[type], y0);
+      end_rows[type] = std::max(end_rows[type], y1);
+    }
+  }
+  int active[Lane::max_lanes];
+  for (int y = 0; y < height; ++y) {
+    int num_active = 0;
+    for (int type = 0; type < num_lanes; ++type) {
+      if (y >= first_rows[type] and y < end_rows[type]) active[num_active++] = type;
+    }
+    write_row(&pixels[y*width], width, y, lane_tops.data(), lane_bottoms.data(), active, num_active,
+              lane_colors.data());
+  }
+}
+
+void SoftwareRenderer::fill_span(uint32_t * span, int count, const sf::Color & color) {
+  if (color.a == 255) {
+    std::fill(span, span + count, pack(color));
+    return;
+  }
+  Blend blend(color);
+  int i = 0;
+#ifdef __SSE2__
+  for (; i + 4 <= count; i += 4) {
+    __m128i * p = reinterpret_cast<__m128i *>(span + i);
+    _mm_storeu_si128(p, blend.apply(_mm_loadu_si128(p)));
+  }
+#endif
+  for (; i < count; ++i) {
+    span[i] = blend.apply(span[i]);
+  }
+}
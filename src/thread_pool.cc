@@ -0,0 +1,97 @@
+#include "thread_pool.h"
+
+namespace {
+
+// Index of the pool worker running on this thread, -1 elsewhere
+thread_local int worker_index = -1;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads)
+  : queued(0), pending(0), next_queue(0), stopping(false) {
+  num_threads = std::max(1, num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    queues.push_back(std::unique_ptr<Queue>(new Queue()));
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads.push_back(std::thread(&ThreadPool::work, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread & thread : threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::submit(const std::function<void()> & task) {
+  int index = worker_index;
+  if (index < 0) index = next_queue++ % queues.size();
+  ++pending;
+  {
+    Queue & queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  ++queued;
+  {
+    // Taking the lock orders this with a worker checking queued before sleeping
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  wake.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return pending == 0; });
+}
+
+int ThreadPool::size() const {
+  return threads.size();
+}
+
+void ThreadPool::work(int index) {
+  worker_index = index;
+  std::function<void()> task;
+  while (true) {
+    if (pop(index, task)) {
+      task();
+      task = nullptr;
+      if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this] { return stopping or queued > 0; });
+    if (stopping and queued == 0) return;
+  }
+}
+
+bool ThreadPool::pop(int index, std::function<void()> & task) {
+  int count = queues.size();
+  for (int i = 0; i < count; ++i) {
+    Queue & queue = *queues[(index + i) % count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) continue;
+    // Own tasks newest first, stolen ones oldest first
+    if (i == 0) {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+    }
+    else {
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+    }
+    --queued;
+    return true;
+  }
+  return false;
+}
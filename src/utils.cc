@@ -0,0 +1,10 @@
+#include "utils.h"
+
+void get_percentiles(int64_t * times, int count, float & p50, float & p99, float & max) {
+  p50 = p99 = max = 0.0f;
+  if (count <= 0) return;
+  std::sort(times, times + count);
+  p50 = times[count/2] / 1e6f;
+  p99 = times[std::min(count - 1, count*99/100)] / 1e6f;
+  max = times[count - 1] / 1e6f;
+}
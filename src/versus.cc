@@ -0,0 +1,105 @@
+#include "versus.h"
+
+namespace {
+
+const unsigned int action_bits = (1u << Input::PLAYER_ACTION) |
+                                 (1u << (Input::PLAYER_ACTION + Input::tap_shift));
+
+bool is_idle(const Simulation & simulation) {
+  return simulation.get_status() == Simulation::MENU or simulation.get_status() == Simulation::GAME_OVER;
+}
+
+// Whether the simulation's input sees action pressed once updated with keys
+bool presses_action(const Simulation & simulation, unsigned int keys) {
+  unsigned int pressed = (keys & ~simulation.get_input().get_keys()) | keys >> Input::tap_shift;
+  return pressed & (1u << Input::PLAYER_ACTION);
+}
+
+// Changes whenever what is exchanged or how it is used changes
+const uint32_t protocol_version = 1;
+
+}  // namespace
+
+Versus::Versus(Simulation & local, const Simulation::Settings & settings, Lockstep & lockstep)
+  : local(local), opponent(settings), lockstep(lockstep), seed(0), round(0), step_time(0.0f),
+    reported_desync(false) {}
+
+Versus::~Versus() {}
+
+void Versus::init(uint64_t seed) {
+  this->seed = seed;
+  round = 0;
+  reported_desync = false;
+  opponent.init(seed);
+}
+
+bool Versus::needs_keys() const {
+  return lockstep.needs_keys();
+}
+
+bool Versus::wait(unsigned int keys, int64_t timeout) {
+  lockstep.send(keys);
+  return lockstep.wait(timeout);
+}
+
+void Versus::update(float delta_time) {
+  step_time = delta_time;
+  Simulation * simulations[2] = { &local, &opponent };
+  unsigned int keys[2] = { lockstep.get_local_keys(), lockstep.get_remote_keys() };
+  bool start = is_idle(local) and is_idle(opponent) and
+               (presses_action(local, keys[0]) or presses_action(opponent, keys[1]));
+  if (start) ++round;
+  for (int i = 0; i < 2; ++i) {
+    Simulation & simulation = *simulations[i];
+    if (start) {
+      // Both restart and leave the menu in this step, whoever pressed
+      simulation.init(seed + round);
+      keys[i] |= 1u << (Input::PLAYER_ACTION + Input::tap_shift);
+    }
+    else if (is_idle(simulation)) {
+      keys[i] &= ~action_bits;
+    }
+    simulation.update(delta_time, keys[i]);
+  }
+  lockstep.end_step(local.get_hash(), opponent.get_hash());
+  if (!reported_desync and lockstep.get_desync_step() >= 0) {
+    std::cerr << "Versus: the other side's state differs after step " << lockstep.get_desync_step() << std::endl;
+    reported_desync = true;
+  }
+}
+
+const Simulation & Versus::get_opponent() const {
+  return opponent;
+}
+
+const Lockstep & Versus::get_lockstep() const {
+  return lockstep;
+}
+
+int Versus::get_round() const {
+  return round;
+}
+
+void Versus::print(std::ostream & out) const {
+  Profiler::Stats round_trip = lockstep.get_round_trip();
+  Profiler::Stats wait = lockstep.get_wait();
+  out << "Versus: " << lockstep.get_step() << " steps, " << round << " rounds, input delay "
+      << lockstep.get_input_delay() << " steps (" << lockstep.get_input_delay()*step_time*1000.0f
+      << " ms), round trip p50 " << round_trip.p50 << " ms, p99 " << round_trip.p99 << " ms, waited "
+      << lockstep.get_wait_count() << " times, p99 " << wait.p99 << " ms, max " << wait.max
+      << " ms, opponent state " << std::hex << opponent.get_hash() << std::dec;
+  if (lockstep.get_desync_step() >= 0) out << ", desync after step " << lockstep.get_desync_step();
+  out << std::endl;
+}
+
+uint32_t Versus::get_session(uint64_t seed, int rate, const Simulation::Settings & settings) {
+  // FNV-1a over everything both sides have to agree on
+  uint64_t values[4] = { protocol_version, seed, uint64_t(rate), uint64_t(settings.num_types) };
+  uint32_t hash = 0x811c9dc5u;
+  for (uint64_t value : values) {
+    for (int i = 0; i < 8; ++i) {
+      hash = (hash ^ ((value >> (8*i)) & 0xff)) * 0x01000193u;
+    }
+  }
+  return hash;
+}
@@ -0,0 +1,201 @@
+#include "simulation.h"
+#include "autopilot.h"
+#include "replay.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <chrono>
+#include <functional>
+#include <cstring>
+
+// Difficulty sweep: plays many headless games over a grid of Settings
+// values on a thread pool and writes one CSV row per game.
+
+namespace {
+
+struct Parameter {
+  const char * name;
+  std::function<void(Simulation::Settings &, double)> set;
+  std::vector<double> values;
+};
+
+struct Run {
+  int point;
+  uint64_t seed;
+  float survival;
+  float score;
+  long steps;
+};
+
+std::vector<double> parse_values(const char * list) {
+  std::vector<double> values;
+  std::stringstream ss(list);
+  std::string value;
+  while (std::getline(ss, value, ',')) {
+    values.push_back(atof(value.c_str()));
+  }
+  return values;
+}
+
+// Plays one game until the player dies or max_steps pass
+void play(const Simulation::Settings & settings, int rate, long max_steps,
+          const std::vector<unsigned int> * replay_keys, Run & run) {
+  const float delta_time = 1.0f/rate;
+  Simulation simulation(settings);
+  simulation.init(run.seed);
+  Autopilot autopilot;
+  bool played = false;
+  long playing_steps = 0;
+  long step = 0;
+  for (; step < max_steps; ++step) {
+    unsigned int keys;
+    if (replay_keys) keys = step < long(replay_keys->size()) ? (*replay_keys)[step] : 0;
+    else keys = autopilot.get_keys(simulation);
+    simulation.update(delta_time, keys);
+    if (simulation.get_status() == Simulation::PLAYING) {
+      played = true;
+      ++playing_steps;
+      run.score = simulation.get_score();
+    }
+    else if (played) {
+      break;
+    }
+  }
+  run.survival = playing_steps*delta_time;
+  run.steps = step;
+}
+
+}  // namespace
+
+int main(int argc, char * argv[]) {
+  std::vector<Parameter> parameters = {
+    { "num_types", [](Simulation::Settings & s, double v) { s.num_types = v; }, {} },
+    { "walls_width", [](Simulation::Settings & s, double v) { s.walls_width = v; }, {} },
+    { "start_speed", [](Simulation::Settings & s, double v) { s.start_speed = v; }, {} },
+    { "walls_max_dist", [](Simulation::Settings & s, double v) { s.walls_max_dist = v; }, {} },
+    { "init_one_way_probability",
+      [](Simulation::Settings & s, double v) { s.init_one_way_probability = v; }, {} },
+    { "init_walls_next_target_timeout",
+      [](Simulation::Settings & s, double v) { s.init_walls_next_target_timeout = v; }, {} },
+    { "min_walls_next_target_timeout",
+      [](Simulation::Settings & s, double v) { s.min_walls_next_target_timeout = v; }, {} },
+  };
+  int runs = 100;
+  int threads = std::thread::hardware_concurrency();
+  int rate = 240;
+  float max_time = 300.0f;
+  const char * out_path = "sweep.csv";
+  const char * replay_path = NULL;
+  for (int i = 1; i < argc; ++i) {
+    bool known = false;
+    if (argv[i][0] == '-' and argv[i][1] == '-' and i+1 < argc) {
+      for (Parameter & parameter : parameters) {
+        if (strcmp(argv[i]+2, parameter.name) == 0) {
+          parameter.values = parse_values(argv[++i]);
+          known = true;
+        }
+      }
+      if (known) continue;
+      known = true;
+      if (strcmp(argv[i], "--runs") == 0) runs = std::max(1, atoi(argv[++i]));
+      else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+      else if (strcmp(argv[i], "--rate") == 0) rate = std::max(1, atoi(argv[++i]));
+      else if (strcmp(argv[i], "--max-time") == 0) max_time = atof(argv[++i]);
+      else if (strcmp(argv[i], "--out") == 0) out_path = argv[++i];
+      else if (strcmp(argv[i], "--replay") == 0) replay_path = argv[++i];
+      else known = false;
+    }
+    if (!known) {
+      std::cerr << "Usage: " << argv[0] << " [--PARAMETER v1,v2,...]... [--runs N] [--threads N]"
+                << " [--rate HZ] [--max-time S] [--replay FILE] [--out FILE]\nParameters:";
+      for (const Parameter & parameter : parameters) std::cerr << " " << parameter.name;
+      std::cerr << std::endl;
+      return 1;
+    }
+  }
+
+  // A recording replaces the autopilot, with its own rate, seed and lane count
+  std::vector<unsigned int> replay_keys;
+  uint64_t replay_seed = 0;
+  int replay_lanes = 0;
+  if (replay_path) {
+    Replay replay;
+    if (!replay.open(replay_path)) return 1;
+    for (const Parameter & parameter : parameters) {
+      if (strcmp(parameter.name, "num_types") == 0 and !parameter.values.empty()) {
+        std::cerr << "A replay brings its own lane count, num_types cannot be swept with it" << std::endl;
+        return 1;
+      }
+    }
+    rate = replay.get_rate();
+    replay_seed = replay.get_seed();
+    replay_lanes = replay.get_lanes();
+    unsigned int keys;
+    while (replay.next(keys)) replay_keys.push_back(keys);
+    runs = 1;
+  }
+
+  // Every combination of the given values, unset parameters keep the default
+  std::vector<Simulation::Settings> points(1);
+  std::vector<std::vector<double>> point_values(1);
+  for (const Parameter & parameter : parameters) {
+    if (parameter.values.empty()) continue;
+    std::vector<Simulation::Settings> next_points;
+    std::vector<std::vector<double>> next_values;
+    for (unsigned int p = 0; p < points.size(); ++p) {
+      for (double value : parameter.values) {
+        next_points.push_back(points[p]);
+        parameter.set(next_points.back(), value);
+        next_values.push_back(point_values[p]);
+        next_values.back().push_back(value);
+      }
+    }
+    points.swap(next_points);
+    point_values.swap(next_values);
+  }
+  if (replay_path) {
+    for (Simulation::Settings & point : points) point.num_types = replay_lanes;
+  }
+
+  std::vector<Run> results(points.size()*runs);
+  long max_steps = long(max_time*rate);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  {
+    ThreadPool pool(threads);
+    threads = pool.size();
+    for (unsigned int p = 0; p < points.size(); ++p) {
+      for (int r = 0; r < runs; ++r) {
+        Run & run = results[p*runs + r];
+        run.point = p;
+        run.seed = replay_path ? replay_seed : r + 1;
+        run.score = 0.0f;
+        const Simulation::Settings & settings = points[p];
+        const std::vector<unsigned int> * keys = replay_path ? &replay_keys : NULL;
+        pool.submit([&settings, rate, max_steps, keys, &run] {
+          play(settings, rate, max_steps, keys, run);
+        });
+      }
+    }
+    pool.wait();
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::ofstream out(out_path);
+  if (!out.is_open()) {
+    std::cerr << "Error writing " << out_path << std::endl;
+    return 1;
+  }
+  for (const Parameter & parameter : parameters) {
+    if (!parameter.values.empty()) out << parameter.name << ",";
+  }
+  out << "seed,survival_s,score,steps\n";
+  long total_steps = 0;
+  for (const Run & run : results) {
+    for (double value : point_values[run.point]) out << value << ",";
+    out << run.seed << "," << run.survival << "," << int(run.score) << "," << run.steps << "\n";
+    total_steps += run.steps;
+  }
+  std::cout << results.size() << " games on " << threads << " threads in " << elapsed << " s ("
+            << results.size()/elapsed << " games/s, " << total_steps/elapsed << " steps/s), wrote "
+            << out_path << std::endl;
+  return 0;
+}